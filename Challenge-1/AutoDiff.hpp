@@ -0,0 +1,196 @@
+#ifndef AUTODIFF_HPP
+#define AUTODIFF_HPP
+
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <vector>
+#include "GradientMethodUtils.hpp"
+
+// Automatic differentiation of functions written as templates (e.g. generic lambdas) on the scalar type:
+// forward mode with dual numbers, one pass per component of the gradient, and reverse mode on a tape,
+// whose gradient costs a few times one evaluation of the function whatever the dimension.
+// The mathematical functions are found by argument dependent lookup, so the function must call them
+// unqualified (using std::sin; ... sin(x)) instead of std::sin(x)
+
+namespace pacs{
+
+    // Dual number value + derivative * eps, with eps^2 = 0
+    struct Dual
+    {
+        Scalar value = 0;
+        Scalar derivative = 0;
+
+        Dual() = default;
+        Dual(Scalar v, Scalar d = 0) : value(v), derivative(d) {}
+    };
+
+    inline Dual operator+(const Dual &a, const Dual &b) { return {a.value + b.value, a.derivative + b.derivative}; }
+    inline Dual operator-(const Dual &a, const Dual &b) { return {a.value - b.value, a.derivative - b.derivative}; }
+    inline Dual operator*(const Dual &a, const Dual &b) { return {a.value*b.value, a.derivative*b.value + a.value*b.derivative}; }
+    inline Dual operator/(const Dual &a, const Dual &b)
+    {
+        return {a.value/b.value, (a.derivative*b.value - a.value*b.derivative)/(b.value*b.value)};
+    }
+    inline Dual operator-(const Dual &a) { return {-a.value, -a.derivative}; }
+    inline Dual &operator+=(Dual &a, const Dual &b) { return a = a + b; }
+    inline Dual &operator-=(Dual &a, const Dual &b) { return a = a - b; }
+    inline Dual &operator*=(Dual &a, const Dual &b) { return a = a*b; }
+    inline Dual &operator/=(Dual &a, const Dual &b) { return a = a/b; }
+    inline bool operator<(const Dual &a, const Dual &b) { return a.value < b.value; }
+    inline bool operator>(const Dual &a, const Dual &b) { return a.value > b.value; }
+
+    inline Dual sin(const Dual &a) { return {std::sin(a.value), std::cos(a.value)*a.derivative}; }
+    inline Dual cos(const Dual &a) { return {std::cos(a.value), -std::sin(a.value)*a.derivative}; }
+    inline Dual exp(const Dual &a) { Scalar e = std::exp(a.value); return {e, e*a.derivative}; }
+    inline Dual log(const Dual &a) { return {std::log(a.value), a.derivative/a.value}; }
+    inline Dual sqrt(const Dual &a) { Scalar s = std::sqrt(a.value); return {s, a.derivative/(2*s)}; }
+    inline Dual pow(const Dual &a, Scalar p) { return {std::pow(a.value, p), p*std::pow(a.value, p - 1)*a.derivative}; }
+    inline Dual abs(const Dual &a) { return a.value < 0 ? -a : a; }
+
+    // Tape of the reverse mode: each operation records its operands and the partial derivatives
+    // with respect to them. It keeps its storage, so after the first gradient it does not allocate
+    class Tape
+    {
+    public:
+        static constexpr std::size_t none = std::numeric_limits<std::size_t>::max();
+
+        struct Node
+        {
+            std::size_t parents[2];
+            Scalar partials[2];
+        };
+
+        std::size_t record(std::size_t p0, Scalar d0, std::size_t p1 = none, Scalar d1 = 0)
+        {
+            nodes.push_back({{p0, p1}, {d0, d1}});
+            return nodes.size() - 1;
+        }
+
+        void clear() { nodes.clear(); }
+
+        // Adjoints of the first n nodes (the inputs) for the output node
+        void gradient(std::size_t output, std::size_t n, Vector &g)
+        {
+            adjoints.assign(nodes.size(), 0);
+            if(output != none){
+                adjoints[output] = 1;
+                for(std::size_t k = output + 1; k-- > n;){
+                    for(std::size_t p = 0; p < 2; ++p){
+                        if(nodes[k].parents[p] != none){
+                            adjoints[nodes[k].parents[p]] += nodes[k].partials[p]*adjoints[k];
+                        }
+                    }
+                }
+            }
+            for(std::size_t i = 0; i < n; ++i){
+                g[i] = adjoints[i];
+            }
+        }
+
+    private:
+        std::vector<Node> nodes;
+        std::vector<Scalar> adjoints;
+    };
+
+    // Tape recording the operations of the current thread
+    inline thread_local Tape *activeTape = nullptr;
+
+    // Variable of the reverse mode: its value and its node on the active tape, none for constants
+    struct Var
+    {
+        Scalar value = 0;
+        std::size_t index = Tape::none;
+
+        Var() = default;
+        Var(Scalar v) : value(v) {}
+        Var(Scalar v, std::size_t i) : value(v), index(i) {}
+    };
+
+    namespace detail{
+        // Make a tape the active one for the lifetime of the object
+        struct ActiveTape
+        {
+            Tape *previous;
+            explicit ActiveTape(Tape &tape) : previous(activeTape) { activeTape = &tape; }
+            ~ActiveTape() { activeTape = previous; }
+        };
+
+        inline Var unary(const Var &a, Scalar value, Scalar da)
+        {
+            if(a.index == Tape::none){
+                return Var(value);
+            }
+            return Var(value, activeTape->record(a.index, da));
+        }
+
+        inline Var binary(const Var &a, const Var &b, Scalar value, Scalar da, Scalar db)
+        {
+            if(a.index == Tape::none){
+                return unary(b, value, db);
+            }
+            if(b.index == Tape::none){
+                return unary(a, value, da);
+            }
+            return Var(value, activeTape->record(a.index, da, b.index, db));
+        }
+    }
+
+    inline Var operator+(const Var &a, const Var &b) { return detail::binary(a, b, a.value + b.value, 1, 1); }
+    inline Var operator-(const Var &a, const Var &b) { return detail::binary(a, b, a.value - b.value, 1, -1); }
+    inline Var operator*(const Var &a, const Var &b) { return detail::binary(a, b, a.value*b.value, b.value, a.value); }
+    inline Var operator/(const Var &a, const Var &b)
+    {
+        return detail::binary(a, b, a.value/b.value, 1/b.value, -a.value/(b.value*b.value));
+    }
+    inline Var operator-(const Var &a) { return detail::unary(a, -a.value, -1); }
+    inline Var &operator+=(Var &a, const Var &b) { return a = a + b; }
+    inline Var &operator-=(Var &a, const Var &b) { return a = a - b; }
+    inline Var &operator*=(Var &a, const Var &b) { return a = a*b; }
+    inline Var &operator/=(Var &a, const Var &b) { return a = a/b; }
+    inline bool operator<(const Var &a, const Var &b) { return a.value < b.value; }
+    inline bool operator>(const Var &a, const Var &b) { return a.value > b.value; }
+
+    inline Var sin(const Var &a) { return detail::unary(a, std::sin(a.value), std::cos(a.value)); }
+    inline Var cos(const Var &a) { return detail::unary(a, std::cos(a.value), -std::sin(a.value)); }
+    inline Var exp(const Var &a) { Scalar e = std::exp(a.value); return detail::unary(a, e, e); }
+    inline Var log(const Var &a) { return detail::unary(a, std::log(a.value), 1/a.value); }
+    inline Var sqrt(const Var &a) { Scalar s = std::sqrt(a.value); return detail::unary(a, s, 1/(2*s)); }
+    inline Var pow(const Var &a, Scalar p) { return detail::unary(a, std::pow(a.value, p), p*std::pow(a.value, p - 1)); }
+    inline Var abs(const Var &a) { return a.value < 0 ? -a : a; }
+
+    // Gradient by forward mode: n evaluations of f on dual numbers, one for each direction. For small n
+    template <typename F>
+    GradientFunction forwardGradient(F f, unsigned size)
+    {
+        return [f, size, xd = std::vector<Dual>(size)](const Vector &x, Vector &g) mutable {
+            for(std::size_t i = 0; i < size; ++i){
+                xd[i] = Dual(x[i]);
+            }
+            for(std::size_t i = 0; i < size; ++i){
+                xd[i].derivative = 1;
+                g[i] = Dual(f(xd)).derivative;
+                xd[i].derivative = 0;
+            }
+        };
+    }
+
+    // Gradient by reverse mode: one evaluation of f recorded on a tape and one sweep back, whose cost
+    // does not depend on n. The tape is owned by the gradient, which must not be called concurrently
+    template <typename F>
+    GradientFunction reverseGradient(F f, unsigned size)
+    {
+        return [f, size, tape = Tape(), xv = std::vector<Var>(size)](const Vector &x, Vector &g) mutable {
+            detail::ActiveTape active(tape);
+            tape.clear();
+            for(std::size_t i = 0; i < size; ++i){
+                xv[i] = Var(x[i], tape.record(Tape::none, 0));
+            }
+            Var y = f(xv);
+            tape.gradient(y.index, size, g);
+        };
+    }
+
+}
+
+#endif
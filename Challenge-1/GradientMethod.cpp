@@ -1,13 +1,13 @@
 #include "GradientMethod.hpp"
 #include "GradientMethodUtils.hpp"
+#include "GradientMethodEngine.hpp"
 #include <iostream>
 
 namespace pacs{
 
     bool verifyCondition(const Vector & oldX, const Vector & newX, const GradientMethodData & data)
     {
-        Vector tmp = subVector(newX, oldX);
-        if(euclideanNorm(tmp) < data.epsS){
+        if(std::sqrt(squaredDistance(newX, oldX)) < data.epsS){
             return false;
         }
         if(std::abs(data.f({newX}) - data.f({oldX})) < data.epsR){
@@ -20,29 +20,21 @@ namespace pacs{
     Scalar armijoRule(const Vector & oldX, const GradientMethodData & data,const unsigned & iter){
 
         Scalar delta = 0.05;
-        Function f = data.f;
         Scalar alpha0 = data.alpha0;
 
-        Vector tmp0 = scalarGradProd(alpha0, data.grad, oldX);
-        Vector tmp = subVector(oldX, tmp0);
+        // The gradient and f at oldX do not change while alpha is halved
+        Vector gradEval(oldX.size());
+        data.grad(oldX, gradEval);
+        Scalar cond = delta*dot(gradEval, gradEval);
+        Scalar fOld = data.f(oldX);
 
-        Scalar one = 1.0;
-        Vector gradEval = scalarGradProd(one, data.grad, oldX);
+        Vector tmp(oldX.size());
+        descentStep(oldX, alpha0, gradEval, tmp);
 
-        Scalar norm = euclideanNorm(gradEval);
-        Scalar cond = delta*alpha0*std::pow(norm, 2);
-        
-        while ( (f({oldX}) - f({tmp})) < cond)
+        while ( (fOld - data.f(tmp)) < alpha0*cond)
         {
             alpha0 = alpha0/2;
-
-            tmp0 = scalarGradProd(alpha0, data.grad, oldX);
-            tmp = subVector(oldX, tmp0);
-
-            gradEval = scalarGradProd(one, data.grad, oldX);
-            norm = euclideanNorm(gradEval);
-            cond = delta*alpha0*std::pow(norm, 2);
-
+            descentStep(oldX, alpha0, gradEval, tmp);
         }
 
         return alpha0;
@@ -62,6 +54,22 @@ namespace pacs{
         return alpha;
     }
 
+    bool isValidStrategy(char strategy){
+        switch (strategy)
+        {
+        case 'a':
+        case 'e':
+        case 'i':
+        case 'm':
+        case 'n':
+        case 'd':
+        case 'l':
+            return true;
+        default:
+            return false;
+        }
+    }
+
     std::function<Scalar(Vector, GradientMethodData, unsigned iter)> selectStrategy(const char &strategy){
         
         std::function<Scalar(Vector, GradientMethodData, unsigned iter)> updateAlpha;
@@ -69,20 +77,24 @@ namespace pacs{
         switch (strategy)
         {
         case 'a':
-            std::cout<<"Armijo rule selected"<<std::endl;
             updateAlpha = armijoRule;
             break;
         case 'e':
-            std::cout<<"Exponential rule selected"<<std::endl;
             updateAlpha = exponentialRule;
             break;
         case 'i':
-            std::cout<<"Inverse rule selected"<<std::endl;
             updateAlpha = inverseRule;
             break;
+        // The accelerated methods and L-BFGS change the direction, not only the step size
+        case 'm':
+        case 'n':
+        case 'd':
+        case 'l':
+            updateAlpha = nullptr;
+            break;
         
         default:
-            std::cout<<"Error: select the correct rule"<<std::endl;
+            std::cerr<<"Error: select the correct rule"<<std::endl;
             updateAlpha = nullptr;
             break;
         }
@@ -91,31 +103,23 @@ namespace pacs{
     }
 
     Vector gradientMethod(const GradientMethodData & data) {
-        Vector oldX = data.xInit;
-        Vector tmp = scalarGradProd(data.alpha0, data.grad, oldX);
-        Vector newX = subVector(oldX, tmp);
-
-        std::function<Scalar(Vector, GradientMethodData, unsigned iter)> updateAlpha = selectStrategy(data.strategy);
-        
-        if(updateAlpha != nullptr){
-            
-            unsigned iter = 0;
-
-            while (verifyCondition(oldX, newX, data) && iter < data.maxIt)
-            {   
-                oldX = newX;
-                Scalar newAlpha = updateAlpha(oldX, data, iter);    
-                Vector tmp = scalarGradProd(newAlpha, data.grad, oldX);
-                newX = subVector(oldX, tmp);
-
-                std::cout<<newAlpha<<std::endl;
+        EvaluationCounters counters;
+        return gradientMethod(data, counters);
+    }
 
-                ++iter;
-            }   
+    Vector gradientMethod(const GradientMethodData & data, EvaluationCounters & counters, TraceSink * trace) {
+        // Runtime wrapper of the engine, which does not print in the loop: the iterations are recorded
+        // in trace if given. The loop works on the workspace of the engine and does not allocate
+        if(!isValidStrategy(data.strategy)){
+            std::cerr<<"Error: select the correct rule"<<std::endl;
+            counters = {};
+            return data.xInit;
         }
 
-        return newX;
-              
+        GradientMethodEngine<Function, GradientFunction> engine(data.f, data.grad, {data.epsS, data.epsR, data.alpha0, data.maxIt, data.strategy, data.momentum, data.memory}, data.xInit.size());
+        Vector min = trace ? engine.minimize(data.xInit, *trace) : engine.minimize(data.xInit);
+        counters = engine.counters();
+        return min;
     }
 
 }
\ No newline at end of file
@@ -1,11 +1,25 @@
+#ifndef GRADIENTMETHOD_HPP
+#define GRADIENTMETHOD_HPP
+
 #include "GradientMethodUtils.hpp"
 #include "GradientMethodData.hpp"
+#include "GradientMethodEngine.hpp"
+#include "GradientMethodTrace.hpp"
 
 namespace pacs{
     Vector gradientMethod(const GradientMethodData & data);
 
+    // As above, also returning the number of evaluations of the function and of the gradient,
+    // and recording the iterations in trace if it is not null (see GradientMethodTrace.hpp)
+    Vector gradientMethod(const GradientMethodData & data, EvaluationCounters & counters, TraceSink * trace = nullptr);
+
+    // True for the strategies run by the engine: 'a', 'e', 'i', 'm', 'n', 'd' and 'l'
+    bool isValidStrategy(char strategy);
+
     // Select the strategy to compute the alpha parameter in the gradient method using function wrapper
-    // The selection is made at runtime but before the enter of the for loop in the gradientMethod function
+    // The selection is made at runtime but before the enter of the for loop in the gradientMethod function.
+    // It returns an empty wrapper for the strategies that are not a step size rule ('m', 'n', 'd', 'l'),
+    // and also prints an error for an unknown strategy
     std::function<Scalar(Vector, GradientMethodData, unsigned iter)> selectStrategy(const char &strategy);
 
     // control of the step length and on the residual for the Gradient method
@@ -19,3 +33,5 @@ namespace pacs{
     Scalar inverseRule(const Vector & oldX, const GradientMethodData & data,const unsigned & iter);
 
 }
+
+#endif
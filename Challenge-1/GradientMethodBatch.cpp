@@ -0,0 +1,97 @@
+#include "GradientMethodBatch.hpp"
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include "GradientMethod.hpp"
+#ifdef PARALLELEXEC
+#include <execution>
+#endif
+
+namespace pacs{
+
+    namespace {
+        // Unknown strategies are rejected before any run, the engine would return xInit as converged
+        void checkStrategy(const GradientMethodData & data)
+        {
+            if(!isValidStrategy(data.strategy)){
+                throw std::invalid_argument(std::string("Unknown strategy '") + data.strategy + "' in a batch of the gradient method");
+            }
+        }
+
+        GradientMethodResult run(const GradientMethodData & data, const Vector & xInit)
+        {
+            auto start = std::chrono::steady_clock::now();
+
+            GradientMethodEngine<Function, GradientFunction> engine(data.f, data.grad, {data.epsS, data.epsR, data.alpha0, data.maxIt, data.strategy, data.momentum, data.memory}, xInit.size());
+            GradientMethodResult result;
+            result.min = engine.minimize(xInit);
+            result.value = engine.minValue();
+            result.iterations = engine.iterations();
+            result.converged = engine.converged();
+            result.counters = engine.counters();
+
+            result.time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            return result;
+        }
+
+        // Call run(i) for i in [0, n), across threads with PARALLELEXEC, and collect the statistics
+        template <typename Run>
+        std::vector<GradientMethodResult> runBatch(std::size_t n, BatchStatistics & statistics, Run && runOne)
+        {
+            auto start = std::chrono::steady_clock::now();
+
+            std::vector<GradientMethodResult> results(n);
+            std::vector<std::size_t> ids(n);
+            std::iota(ids.begin(), ids.end(), 0);
+            auto body = [&](std::size_t i){ results[i] = runOne(i); };
+#ifdef PARALLELEXEC
+            std::for_each(std::execution::par, ids.begin(), ids.end(), body);
+#else
+            std::for_each(ids.begin(), ids.end(), body);
+#endif
+
+            statistics = BatchStatistics();
+            statistics.runs = n;
+            statistics.wallTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if(n == 0){
+                return results;
+            }
+
+            statistics.minIterations = results[0].iterations;
+            for(std::size_t i = 0; i < n; ++i){
+                const GradientMethodResult & r = results[i];
+                statistics.converged += r.converged;
+                statistics.minIterations = std::min(statistics.minIterations, r.iterations);
+                statistics.maxIterations = std::max(statistics.maxIterations, r.iterations);
+                statistics.meanIterations += r.iterations;
+                statistics.fEvaluations += r.counters.f;
+                statistics.gradEvaluations += r.counters.grad;
+                statistics.meanTime += r.time;
+                if(r.value < results[statistics.best].value){
+                    statistics.best = i;
+                }
+            }
+            statistics.meanIterations /= n;
+            statistics.meanTime /= n;
+
+            return results;
+        }
+    }
+
+    std::vector<GradientMethodResult> gradientMethodBatch(const std::vector<GradientMethodData> & batch, BatchStatistics & statistics)
+    {
+        for(const GradientMethodData & data : batch){
+            checkStrategy(data);
+        }
+        return runBatch(batch.size(), statistics, [&batch](std::size_t i){ return run(batch[i], batch[i].xInit); });
+    }
+
+    std::vector<GradientMethodResult> multiStart(const GradientMethodData & data, const std::vector<Vector> & starts, BatchStatistics & statistics)
+    {
+        checkStrategy(data);
+        return runBatch(starts.size(), statistics, [&data, &starts](std::size_t i){ return run(data, starts[i]); });
+    }
+
+}
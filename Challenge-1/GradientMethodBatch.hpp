@@ -0,0 +1,52 @@
+#ifndef GRADIENTMETHODBATCH_HPP
+#define GRADIENTMETHODBATCH_HPP
+
+#include <cstddef>
+#include <vector>
+#include "GradientMethodData.hpp"
+#include "GradientMethodEngine.hpp"
+
+// Batches of independent runs of the gradient method, e.g. one per starting point or parameter set.
+// With PARALLELEXEC (the parallel target) the runs are spread over the work-stealing scheduler of
+// TBB through std::execution::par, otherwise they are run one after the other. The runs do not print:
+// the results are collected and can be reported after the batch
+
+namespace pacs{
+
+    // Result of one run
+    struct GradientMethodResult
+    {
+        Vector min;                     // last iterate
+        Scalar value = 0;               // f(min)
+        unsigned iterations = 0;
+        bool converged = false;         // stopped by the tolerances within maxIt iterations
+        EvaluationCounters counters;    // evaluations of f (including f(min)) and of the gradient
+        double time = 0;                // seconds
+    };
+
+    // Statistics of a batch
+    struct BatchStatistics
+    {
+        std::size_t runs = 0;
+        std::size_t converged = 0;
+        std::size_t best = 0;           // index of the run with the lowest value
+        unsigned minIterations = 0;
+        unsigned maxIterations = 0;
+        double meanIterations = 0;
+        unsigned long fEvaluations = 0;
+        unsigned long gradEvaluations = 0;
+        double meanTime = 0;            // mean time of a run, seconds
+        double wallTime = 0;            // time of the whole batch, seconds
+    };
+
+    // Run the gradient method on each data. Every run copies f and grad, so gradients keeping
+    // a workspace (finite differences, reverse mode AD) are safe to share among the data.
+    // Both functions throw std::invalid_argument, before any run, if a strategy is unknown
+    std::vector<GradientMethodResult> gradientMethodBatch(const std::vector<GradientMethodData> & batch, BatchStatistics & statistics);
+
+    // Run the gradient method on data from each starting point, data.xInit is not used
+    std::vector<GradientMethodResult> multiStart(const GradientMethodData & data, const std::vector<Vector> & starts, BatchStatistics & statistics);
+
+}
+
+#endif
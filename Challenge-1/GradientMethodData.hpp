@@ -1,16 +1,24 @@
+#ifndef GRADIENTMETHODDATA_HPP
+#define GRADIENTMETHODDATA_HPP
+
 #include "GradientMethodUtils.hpp"
 
 namespace pacs{
     struct GradientMethodData
     {
         Function f;
-        Gradient grad;
+        GradientFunction grad; // see fromComponents() for a gradient given by its components
         Vector xInit;
         Scalar epsS;
         Scalar epsR;
         Scalar alpha0;
         unsigned maxIt;
         char strategy; //'a' - Armijo rule, 'e' - Exponential Decay, 'i' - Inverse Decay
+                       //'m' - heavy-ball momentum, 'n' - Nesterov momentum, 'd' - Adam, 'l' - L-BFGS
+        Scalar momentum = 0.9; // 'm', 'n': weight of the previous step, 'd': decay of the first moment
+        unsigned memory = 5;   // 'l': number of pairs kept in the history
     };
     
-}
\ No newline at end of file
+}
+
+#endif
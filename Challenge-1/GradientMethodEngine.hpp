@@ -0,0 +1,481 @@
+#ifndef GRADIENTMETHODENGINE_HPP
+#define GRADIENTMETHODENGINE_HPP
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "GradientMethodUtils.hpp"
+
+// Gradient method templated on the function, the gradient and the dimension of the problem:
+// the callables are called directly (no std::function) and for a dimension known at compile time
+// the vectors are std::array, so the whole iteration can be inlined and never allocates.
+// Besides the step-size rules of plain steepest descent ('a', 'e', 'i') it offers accelerated methods:
+// heavy-ball momentum ('m'), Nesterov momentum ('n'), Adam ('d') with step alpha0, and L-BFGS ('l'),
+// whose direction is built from the last pairs of steps and gradient changes and then line searched.
+// Their work vectors (velocity, moments, history) are allocated by the constructor
+
+namespace pacs{
+
+    // Dimension known only at runtime, the vectors are std::vector allocated once by the engine
+    inline constexpr std::size_t dynamicSize = 0;
+
+    // std::array for a dimension known at compile time, Vector otherwise
+    template <std::size_t N>
+    using EngineVector = std::conditional_t<N == dynamicSize, Vector, std::array<Scalar, N>>;
+
+    // Parameters of the gradient method, as in GradientMethodData
+    struct GradientMethodParameters
+    {
+        Scalar epsS;
+        Scalar epsR;
+        Scalar alpha0;
+        unsigned maxIt;
+        char strategy; //'a' - Armijo rule, 'e' - Exponential Decay, 'i' - Inverse Decay
+                       //'m' - heavy-ball momentum, 'n' - Nesterov momentum, 'd' - Adam, 'l' - L-BFGS
+        Scalar momentum = 0.9; // 'm', 'n': weight of the previous step, 'd': decay of the first moment
+        unsigned memory = 5;   // 'l': number of pairs kept in the history
+    };
+
+    // Observer called after every iteration with the iteration number and the step, by default it does nothing
+    struct NoObserver
+    {
+        void operator()(unsigned, Scalar) const {}
+    };
+
+    // Record of an iteration from x_k to x_{k+1}, passed to the observers callable with it (e.g. TraceSink)
+    struct IterationTrace
+    {
+        unsigned iteration;
+        Scalar alpha;
+        Scalar f;               // f(x_k)
+        Scalar gradientNorm;    // |grad f(x_k)|
+        Scalar stepNorm;        // |x_{k+1} - x_k|
+        double gradientTime;    // seconds spent in the gradient
+        double updateTime;      // in the update of x, line search included
+        double checkTime;       // in the stopping criterion before the iteration
+    };
+
+    // Observers taking an IterationTrace make the engine time the phases and compute the norms;
+    // the others get only the iteration number and the step, and cost nothing more
+    template <typename Observer>
+    inline constexpr bool tracesIterations = std::is_invocable_v<Observer &, const IterationTrace &>;
+
+    // Number of evaluations of the function and of the whole gradient
+    struct EvaluationCounters
+    {
+        unsigned long f = 0;
+        unsigned long grad = 0;
+    };
+
+    // F: Scalar f(const VectorType &x)
+    // G: void grad(const VectorType &x, VectorType &g), writes the whole gradient in g
+    template <typename F, typename G, std::size_t N = dynamicSize>
+    class GradientMethodEngine
+    {
+    public:
+        using VectorType = EngineVector<N>;
+
+        // size is the dimension of the problem when N is dynamicSize, it is ignored otherwise
+        GradientMethodEngine(F fun, G gradient, const GradientMethodParameters &parameters, std::size_t size = N)
+            : f(std::move(fun)), grad(std::move(gradient)), params(parameters)
+        {
+            if constexpr (N == dynamicSize){
+                oldX.resize(size);
+                newX.resize(size);
+                g.resize(size);
+            }
+            switch (params.strategy)
+            {
+            case 'd':
+                resize(secondMoment, size);
+                [[fallthrough]];
+            case 'm':
+            case 'n':
+                resize(velocity, size);
+                break;
+            case 'l':
+                params.memory = std::max(params.memory, 1u);
+                resize(direction, size);
+                sHistory.resize(params.memory);
+                yHistory.resize(params.memory);
+                for(std::size_t k = 0; k < params.memory; ++k){
+                    resize(sHistory[k], size);
+                    resize(yHistory[k], size);
+                }
+                rho.resize(params.memory);
+                twoLoopAlpha.resize(params.memory);
+                break;
+            default:
+                break;
+            }
+        }
+
+        // Minimize starting from xInit and return the last iterate. The strategy is selected once,
+        // before the loop, and the loop is instantiated for each strategy
+        template <typename Observer = NoObserver>
+        const VectorType & minimize(const VectorType &xInit, Observer &&observer = {})
+        {
+            evaluations = {};
+            fOld = {};
+            fNew = {};
+            oldX = xInit;
+            iter = 0;
+            stopped = false;
+
+            switch (params.strategy)
+            {
+            case 'a':
+                run<'a'>(observer);
+                break;
+            case 'e':
+                run<'e'>(observer);
+                break;
+            case 'i':
+                run<'i'>(observer);
+                break;
+            case 'm':
+                run<'m'>(observer);
+                break;
+            case 'n':
+                run<'n'>(observer);
+                break;
+            case 'd':
+                run<'d'>(observer);
+                break;
+            case 'l':
+                run<'l'>(observer);
+                break;
+            default:
+                break;
+            }
+
+            return newX;
+        }
+
+        // Number of iterations of the last minimization
+        unsigned iterations() const { return iter; }
+
+        // True if the last minimization was stopped by the tolerances, also at the last allowed iteration
+        bool converged() const { return stopped; }
+
+        // Evaluations of the function and of the gradient in the last minimization
+        const EvaluationCounters & counters() const { return evaluations; }
+
+        // Value of f at the last iterate, evaluated only if the stopping criterion did not
+        Scalar minValue() { return value(fNew, newX); }
+
+    private:
+        F f;
+        G grad;
+        GradientMethodParameters params;
+
+        VectorType oldX;
+        VectorType newX;
+        VectorType g;
+        unsigned iter = 0;
+        bool stopped = false;
+
+        // Value of f at oldX and at newX, computed at most once for each point and
+        // carried from the line search to the stopping criterion and to the next iteration
+        struct CachedValue
+        {
+            Scalar value = 0;
+            bool known = false;
+        };
+        CachedValue fOld;
+        CachedValue fNew;
+        EvaluationCounters evaluations;
+
+        // Velocity of the momentum methods, first moment of Adam
+        VectorType velocity;
+        // Adam: second moment and powers of the decay rates, for the bias correction
+        VectorType secondMoment;
+        Scalar beta1Power = 1;
+        Scalar beta2Power = 1;
+        // L-BFGS: search direction and ring buffer of the last pairs s = x_{k+1} - x_k, y = g_{k+1} - g_k,
+        // with rho = 1 / (s . y). The pair at head is completed when the gradient at the new point is known
+        VectorType direction;
+        std::vector<VectorType> sHistory;
+        std::vector<VectorType> yHistory;
+        std::vector<Scalar> rho;
+        std::vector<Scalar> twoLoopAlpha;
+        std::size_t head = 0;
+        std::size_t historySize = 0;
+
+        static void resize(VectorType &v, std::size_t size)
+        {
+            if constexpr (N == dynamicSize){
+                v.resize(size);
+            }
+        }
+
+        Scalar value(CachedValue &cache, const VectorType &x)
+        {
+            if(!cache.known){
+                cache.value = f(x);
+                cache.known = true;
+                ++evaluations.f;
+            }
+            return cache.value;
+        }
+
+        // g = grad(oldX), once per point
+        void evalGradient()
+        {
+            grad(oldX, g);
+            ++evaluations.grad;
+        }
+
+        template <char Strategy, typename Observer>
+        void run(Observer &observer)
+        {
+            using Clock = std::chrono::steady_clock;
+            constexpr bool traced = tracesIterations<Observer>;
+            [[maybe_unused]] Clock::time_point checkStart, gradientStart, updateStart;
+
+            start<Strategy>();
+
+            if constexpr (traced){
+                checkStart = Clock::now();
+            }
+            // The tolerances are checked before the number of iterations, so that a run meeting them
+            // after the last allowed iteration is converged
+            while (true)
+            {
+                stopped = !verifyCondition();
+                if(stopped || iter >= params.maxIt){
+                    break;
+                }
+                if constexpr (traced){
+                    gradientStart = Clock::now();
+                }
+                oldX = newX;
+                fOld = fNew;
+                fNew = {};
+                evalGradient();
+                if constexpr (traced){
+                    updateStart = Clock::now();
+                }
+                Scalar alpha = update<Strategy>(); // the point accepted by the line search keeps its value cached
+
+                if constexpr (traced){
+                    const Clock::time_point updateEnd = Clock::now();
+                    // f(oldX) is known from the stopping criterion, so the trace does not evaluate f
+                    observer(IterationTrace{iter, alpha, value(fOld, oldX), std::sqrt(dot(g, g)), std::sqrt(squaredDistance(newX, oldX)),
+                                            std::chrono::duration<double>(updateStart - gradientStart).count(),
+                                            std::chrono::duration<double>(updateEnd - updateStart).count(),
+                                            std::chrono::duration<double>(gradientStart - checkStart).count()});
+                    checkStart = Clock::now();
+                }
+                else{
+                    observer(iter, alpha);
+                }
+
+                ++iter;
+            }
+        }
+
+        // First step from oldX = xInit
+        template <char Strategy>
+        void start()
+        {
+            evalGradient();
+            if constexpr (Strategy == 'm' || Strategy == 'n' || Strategy == 'd'){
+                std::fill(velocity.begin(), velocity.end(), 0);
+                if constexpr (Strategy == 'd'){
+                    std::fill(secondMoment.begin(), secondMoment.end(), 0);
+                    beta1Power = 1;
+                    beta2Power = 1;
+                }
+                update<Strategy>();
+            }
+            else if constexpr (Strategy == 'l'){
+                // Without history the direction is the gradient, line searched from alpha0
+                head = 0;
+                historySize = 0;
+                armijo();
+                beginPair();
+            }
+            else{
+                step(params.alpha0);
+            }
+        }
+
+        // Compute newX from oldX and the gradient in g, return the step length
+        template <char Strategy>
+        Scalar update()
+        {
+            const Scalar beta = params.momentum;
+            const Scalar alpha = params.alpha0;
+            if constexpr (Strategy == 'm'){
+                // v = beta * v - alpha * g, x = x + v
+                for(std::size_t i = 0; i < g.size(); ++i){
+                    velocity[i] = beta*velocity[i] - alpha*g[i];
+                    newX[i] = oldX[i] + velocity[i];
+                }
+                return alpha;
+            }
+            else if constexpr (Strategy == 'n'){
+                // Nesterov momentum with the gradient at the current point: the iterates are the look-ahead
+                // points x + beta * v, so that each iteration evaluates a single gradient
+                for(std::size_t i = 0; i < g.size(); ++i){
+                    const Scalar previous = velocity[i];
+                    velocity[i] = beta*previous - alpha*g[i];
+                    newX[i] = oldX[i] - beta*previous + (1 + beta)*velocity[i];
+                }
+                return alpha;
+            }
+            else if constexpr (Strategy == 'd'){
+                const Scalar beta2 = 0.999;
+                const Scalar epsilon = 1e-8;
+                beta1Power *= beta;
+                beta2Power *= beta2;
+                const Scalar correction1 = 1/(1 - beta1Power);
+                const Scalar correction2 = 1/(1 - beta2Power);
+                for(std::size_t i = 0; i < g.size(); ++i){
+                    velocity[i] = beta*velocity[i] + (1 - beta)*g[i];
+                    secondMoment[i] = beta2*secondMoment[i] + (1 - beta2)*g[i]*g[i];
+                    newX[i] = oldX[i] - alpha*velocity[i]*correction1/(std::sqrt(secondMoment[i]*correction2) + epsilon);
+                }
+                return alpha;
+            }
+            else if constexpr (Strategy == 'l'){
+                endPair();
+                lbfgsDirection();
+                Scalar slope = dot(g, direction);
+                if(!(slope > 0)){
+                    // Not a descent direction: restart from steepest descent
+                    historySize = 0;
+                    direction = g;
+                    slope = dot(g, g);
+                }
+                // The quasi-Newton step has length 1, the steepest descent one is scaled by alpha0
+                Scalar length = armijo(direction, slope, historySize > 0 ? 1 : alpha);
+                beginPair();
+                return length;
+            }
+            else{
+                Scalar length = updateAlpha<Strategy>();
+                step(length);
+                return length;
+            }
+        }
+
+        // newX = oldX - alpha * d
+        void step(Scalar alpha, const VectorType &d)
+        {
+            descentStep(oldX, alpha, d, newX);
+        }
+
+        // newX = oldX - alpha * g
+        void step(Scalar alpha)
+        {
+            step(alpha, g);
+        }
+
+        // Store s = newX - oldX and -g in the ring buffer, y is completed by endPair()
+        void beginPair()
+        {
+            VectorType &s = sHistory[head];
+            VectorType &y = yHistory[head];
+            for(std::size_t i = 0; i < g.size(); ++i){
+                s[i] = newX[i] - oldX[i];
+                y[i] = -g[i];
+            }
+        }
+
+        // y = g_{k+1} - g_k with the new gradient in g; the pair is kept only if s . y > 0,
+        // which keeps the approximation of the inverse Hessian positive definite
+        void endPair()
+        {
+            axpy(1.0, g, yHistory[head]);
+            const Scalar sy = dot(sHistory[head], yHistory[head]);
+            if(sy > 0){
+                rho[head] = 1/sy;
+                head = (head + 1) % params.memory;
+                historySize = std::min<std::size_t>(historySize + 1, params.memory);
+            }
+        }
+
+        // direction = H g by the two-loop recursion, H approximates the inverse Hessian
+        // from the pairs in the history and the scaling (s . y) / (y . y) of the newest one
+        void lbfgsDirection()
+        {
+            const std::size_t m = params.memory;
+            direction = g;
+            std::size_t k = head;
+            for(std::size_t p = 0; p < historySize; ++p){
+                k = (k + m - 1) % m;
+                twoLoopAlpha[k] = rho[k]*dot(sHistory[k], direction);
+                axpy(-twoLoopAlpha[k], yHistory[k], direction);
+            }
+            if(historySize > 0){
+                const std::size_t newest = (head + m - 1) % m;
+                const Scalar gamma = 1/(rho[newest]*dot(yHistory[newest], yHistory[newest]));
+                for(auto &d : direction){
+                    d *= gamma;
+                }
+            }
+            for(std::size_t p = 0; p < historySize; ++p){
+                const Scalar b = rho[k]*dot(yHistory[k], direction);
+                axpy(twoLoopAlpha[k] - b, sHistory[k], direction);
+                k = (k + 1) % m;
+            }
+        }
+
+        // control of the step length and on the residual, as verifyCondition()
+        bool verifyCondition()
+        {
+            if(std::sqrt(squaredDistance(newX, oldX)) < params.epsS){
+                return false;
+            }
+            return std::abs(value(fNew, newX) - value(fOld, oldX)) >= params.epsR;
+        }
+
+        template <char Strategy>
+        Scalar updateAlpha()
+        {
+            if constexpr (Strategy == 'a'){
+                return armijo();
+            }
+            else if constexpr (Strategy == 'e'){
+                return params.alpha0*std::exp(-(5.0*iter));
+            }
+            else{
+                return params.alpha0/(1 + 0.01*iter);
+            }
+        }
+
+        // Armijo rule on the gradient in g
+        Scalar armijo()
+        {
+            return armijo(g, dot(g, g), params.alpha0);
+        }
+
+        // Armijo rule along -d, slope = g . d, starting from alpha. The candidate points are built
+        // in newX, so the value of f at the accepted one is the value at the new point
+        Scalar armijo(const VectorType &d, Scalar slope, Scalar alpha)
+        {
+            const Scalar delta = 0.05;
+
+            const Scalar f0 = value(fOld, oldX);
+            step(alpha, d);
+            while (f0 - value(fNew, newX) < delta*alpha*slope)
+            {
+                alpha = alpha/2;
+                step(alpha, d);
+                fNew = {};
+            }
+
+            return alpha;
+        }
+    };
+
+}
+
+#endif
@@ -0,0 +1,34 @@
+#include "GradientMethodTrace.hpp"
+#include <limits>
+
+namespace pacs{
+
+    void TraceSink::writeCsv(std::ostream & out) const
+    {
+        auto precision = out.precision(std::numeric_limits<Scalar>::digits10);
+        out<<"iteration,alpha,f,gradient_norm,step_norm,gradient_time,update_time,check_time\n";
+        for(std::size_t i = 0; i < count; ++i){
+            const IterationTrace & t = records[i];
+            out<<t.iteration<<','<<t.alpha<<','<<t.f<<','<<t.gradientNorm<<','<<t.stepNorm<<','
+               <<t.gradientTime<<','<<t.updateTime<<','<<t.checkTime<<'\n';
+        }
+        out.precision(precision);
+    }
+
+    void TraceSink::writeJson(std::ostream & out) const
+    {
+        auto precision = out.precision(std::numeric_limits<Scalar>::digits10);
+        out<<"[";
+        for(std::size_t i = 0; i < count; ++i){
+            const IterationTrace & t = records[i];
+            out<<(i > 0 ? ",\n " : "\n ")
+               <<"{\"iteration\": "<<t.iteration<<", \"alpha\": "<<t.alpha<<", \"f\": "<<t.f
+               <<", \"gradient_norm\": "<<t.gradientNorm<<", \"step_norm\": "<<t.stepNorm
+               <<", \"gradient_time\": "<<t.gradientTime<<", \"update_time\": "<<t.updateTime
+               <<", \"check_time\": "<<t.checkTime<<"}";
+        }
+        out<<"\n]\n";
+        out.precision(precision);
+    }
+
+}
@@ -0,0 +1,53 @@
+#ifndef GRADIENTMETHODTRACE_HPP
+#define GRADIENTMETHODTRACE_HPP
+
+#include <cstddef>
+#include <ostream>
+#include <vector>
+#include "GradientMethodEngine.hpp"
+
+// Trace of the iterations of the gradient method, recorded in memory and written after the run
+// instead of printing in the loop. Passed as observer it makes the engine record an IterationTrace
+// per iteration; without it the engine neither times the phases nor computes the norms
+
+namespace pacs{
+
+    class TraceSink
+    {
+    public:
+        // The records are allocated here, the iterations beyond capacity are counted but not kept
+        explicit TraceSink(std::size_t capacity) : records(capacity) {}
+
+        void operator()(const IterationTrace & trace)
+        {
+            if(count < records.size()){
+                records[count++] = trace;
+            }
+            else{
+                ++lost;
+            }
+        }
+
+        // Forget the records, keeping the storage
+        void clear() { count = 0; lost = 0; }
+
+        std::size_t size() const { return count; }
+        std::size_t capacity() const { return records.size(); }
+        std::size_t dropped() const { return lost; }
+        const IterationTrace & operator[](std::size_t i) const { return records[i]; }
+
+        // One line per iteration, with a header
+        void writeCsv(std::ostream & out) const;
+
+        // An array of objects, one per iteration
+        void writeJson(std::ostream & out) const;
+
+    private:
+        std::vector<IterationTrace> records;
+        std::size_t count = 0;
+        std::size_t lost = 0;
+    };
+
+}
+
+#endif
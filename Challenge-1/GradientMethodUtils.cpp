@@ -1,57 +1,139 @@
 #include "GradientMethodUtils.hpp"
+#include <algorithm>
+#include <numeric>
+#include <thread>
+#ifdef PARALLELEXEC
+#include <execution>
+#endif
 
 namespace pacs{
 
     Scalar euclideanNorm(const Vector &v){
-        Scalar sum = 0;
-        for(auto x : v){
-            sum += std::pow(x, 2);
-        }
+        return std::sqrt(dot(v, v));
+    };
 
-        return std::sqrt(sum);
+    void evalGradient(const Gradient &grad, const Vector &x, Vector &g)
+    {
+        for(std::size_t i = 0; i < grad.size(); ++i){
+            g[i] = grad[i](x);
+        }
     };
 
     Vector scalarGradProd(const Scalar &s, const Gradient &v,const Vector &x)
     {
         Vector newVec(v.size());
+        evalGradient(v, x, newVec);
 
-        for(int i = 0; i < v.size(); ++i){
-            newVec[i] = s*v[i]({x});
+        for(auto &y : newVec){
+            y *= s;
         }
-        
 
         return newVec;
     };
 
 
     Vector subVector(const Vector &v1, const Vector &v2){
-        Vector newVec(v1.size());
-
-        for(int i = 0; i < v1.size(); ++i){
-            newVec[i] = v1[i] - v2[i];
-        }
-        
+        Vector newVec(v1);
+        axpy(-1.0, v2, newVec);
 
         return newVec;
 
     };
 
-    Gradient finiteDiff(Function f, unsigned size) {
-        Gradient grad;
+    namespace {
+        // Indices 0, ..., blocks - 1 of the blocks of components evaluated by different threads, kept by the
+        // gradient so that the parallel loop does not allocate them at every call
+        std::vector<std::size_t> gradientBlocks(std::size_t size, bool parallel)
+        {
+            std::size_t blocks = 1;
+#ifdef PARALLELEXEC
+            if(parallel){
+                blocks = std::max<std::size_t>(1, std::min<std::size_t>(size, std::thread::hardware_concurrency()));
+            }
+#endif
+            std::vector<std::size_t> ids(blocks);
+            std::iota(ids.begin(), ids.end(), 0);
+            return ids;
+        }
 
-        const double h = 1e-5;
+        // Call body(b, first, last) on the blocks of components [first, last), in parallel if there are several
+        template <typename Body>
+        void forBlocks(std::size_t size, const std::vector<std::size_t> &ids, Body &&body)
+        {
+#ifdef PARALLELEXEC
+            if(const std::size_t blocks = ids.size(); blocks > 1){
+                std::for_each(std::execution::par, ids.begin(), ids.end(), [&](std::size_t b){
+                    body(b, b*size/blocks, (b + 1)*size/blocks);
+                });
+                return;
+            }
+#endif
+            body(0, 0, size);
+        }
+    }
 
-        for (unsigned i = 0; i < size; ++i) {
+    GradientFunction fromComponents(Gradient grad, bool parallel)
+    {
+        const std::vector<std::size_t> blocks = gradientBlocks(grad.size(), parallel);
+        return [grad, blocks](const Vector &x, Vector &g){
+            forBlocks(grad.size(), blocks, [&](std::size_t, std::size_t first, std::size_t last){
+                for(std::size_t i = first; i < last; ++i){
+                    g[i] = grad[i](x);
+                }
+            });
+        };
+    }
 
-            Function partial_derivative = [f, h, i](Vector x) -> Scalar {
-                Vector x_plus = x;
-                x_plus[i] += h;
-                return (f(x_plus) - f(x)) / (h);
-            };
+    GradientFunction finiteDiff(Function f, unsigned size, bool parallel, Scalar h)
+    {
+        // Perturbed copy of x for each block
+        const std::vector<std::size_t> blocks = gradientBlocks(size, parallel);
+        return [f, size, h, blocks, work = std::vector<Vector>(blocks.size())](const Vector &x, Vector &g) mutable {
+            const Scalar fx = f(x);
+            forBlocks(size, blocks, [&](std::size_t b, std::size_t first, std::size_t last){
+                Vector &xh = work[b];
+                xh = x;
+                for(std::size_t i = first; i < last; ++i){
+                    xh[i] = x[i] + h;
+                    g[i] = (f(xh) - fx)/h;
+                    xh[i] = x[i];
+                }
+            });
+        };
+    }
 
-            grad.push_back(partial_derivative);
-        }
+    GradientFunction centralDiff(Function f, unsigned size, bool parallel, Scalar h)
+    {
+        const std::vector<std::size_t> blocks = gradientBlocks(size, parallel);
+        return [f, size, h, blocks, work = std::vector<Vector>(blocks.size())](const Vector &x, Vector &g) mutable {
+            forBlocks(size, blocks, [&](std::size_t b, std::size_t first, std::size_t last){
+                Vector &xh = work[b];
+                xh = x;
+                for(std::size_t i = first; i < last; ++i){
+                    xh[i] = x[i] + h;
+                    const Scalar fPlus = f(xh);
+                    xh[i] = x[i] - h;
+                    const Scalar fMinus = f(xh);
+                    xh[i] = x[i];
+                    g[i] = (fPlus - fMinus)/(2*h);
+                }
+            });
+        };
+    }
 
-        return grad;
+    GradientFunction complexStepDiff(ComplexFunction f, unsigned size, bool parallel, Scalar h)
+    {
+        const std::vector<std::size_t> blocks = gradientBlocks(size, parallel);
+        return [f, size, h, blocks, work = std::vector<ComplexVector>(blocks.size())](const Vector &x, Vector &g) mutable {
+            forBlocks(size, blocks, [&](std::size_t b, std::size_t first, std::size_t last){
+                ComplexVector &xh = work[b];
+                xh.assign(x.begin(), x.end());
+                for(std::size_t i = first; i < last; ++i){
+                    xh[i] = {x[i], h};
+                    g[i] = f(xh).imag()/h;
+                    xh[i] = x[i];
+                }
+            });
+        };
     }
-}
\ No newline at end of file
+}
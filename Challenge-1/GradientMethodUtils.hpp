@@ -1,13 +1,87 @@
+#ifndef GRADIENTMETHODUTILS_HPP
+#define GRADIENTMETHODUTILS_HPP
+
+#include <complex>
 #include <functional>
+#include <vector>
+#include <cmath>
 
 // Define useful type and function for the Gradient Method
 
 namespace pacs{
     using Scalar = double;
     using Vector = std::vector<Scalar>;
-    using Function = std::function<Scalar(Vector)>;
+    using Function = std::function<Scalar(const Vector &)>;
     using Gradient = std::vector<Function>;
 
+    // Whole gradient evaluated in one call: writes all the components at x in g, which has the size of x
+    using GradientFunction = std::function<void(const Vector &, Vector &)>;
+
+    // Functions of complex vectors, for the complex-step derivative
+    using ComplexVector = std::vector<std::complex<Scalar>>;
+    using ComplexFunction = std::function<std::complex<Scalar>(const ComplexVector &)>;
+
+    // In-place kernels, for Vector and std::array, that never allocate. The loops have independent
+    // iterations (the reductions use four partial sums) so that the compiler can vectorize them
+
+    // Dot product a . b
+    template <typename V>
+    Scalar dot(const V &a, const V &b)
+    {
+        const std::size_t n = a.size();
+        Scalar sum[4] = {0, 0, 0, 0};
+        std::size_t i = 0;
+        for(; i + 4 <= n; i += 4){
+            sum[0] += a[i]*b[i];
+            sum[1] += a[i + 1]*b[i + 1];
+            sum[2] += a[i + 2]*b[i + 2];
+            sum[3] += a[i + 3]*b[i + 3];
+        }
+        for(; i < n; ++i){
+            sum[0] += a[i]*b[i];
+        }
+        return (sum[0] + sum[1]) + (sum[2] + sum[3]);
+    }
+
+    // Squared Euclidean distance |a - b|^2
+    template <typename V>
+    Scalar squaredDistance(const V &a, const V &b)
+    {
+        const std::size_t n = a.size();
+        Scalar sum[4] = {0, 0, 0, 0};
+        std::size_t i = 0;
+        for(; i + 4 <= n; i += 4){
+            for(std::size_t k = 0; k < 4; ++k){
+                sum[k] += (a[i + k] - b[i + k])*(a[i + k] - b[i + k]);
+            }
+        }
+        for(; i < n; ++i){
+            sum[0] += (a[i] - b[i])*(a[i] - b[i]);
+        }
+        return (sum[0] + sum[1]) + (sum[2] + sum[3]);
+    }
+
+    // y = y + alpha * x
+    template <typename V>
+    void axpy(Scalar alpha, const V &x, V &y)
+    {
+        for(std::size_t i = 0; i < x.size(); ++i){
+            y[i] += alpha*x[i];
+        }
+    }
+
+    // out = x - alpha * g, the step of the gradient method in one pass
+    template <typename V>
+    void descentStep(const V &x, Scalar alpha, const V &g, V &out)
+    {
+        for(std::size_t i = 0; i < x.size(); ++i){
+            out[i] = x[i] - alpha*g[i];
+        }
+    }
+
+    // Evaluate all the components of the gradient at x in g, which must have the size of the gradient
+    void evalGradient(const Gradient &grad, const Vector &x, Vector &g);
+
     // Compute the Euclidean norm of a vector
     Scalar euclideanNorm(const Vector &v);
 
@@ -17,7 +91,24 @@ namespace pacs{
     // Perform the subtraction between two vector
     Vector subVector(const Vector &v1, const Vector &v2);
 
-    // compute a Gradient vector using finite difference
-    Gradient finiteDiff(Function f, unsigned size);
+    // The gradients below evaluate the components in one call. With parallel = true, and PARALLELEXEC defined,
+    // the components are split in blocks evaluated across threads (std::execution::par), which pays off
+    // for expensive objectives. The finite differences keep their work vectors, so after the first call
+    // they do not allocate; a gradient must not be called concurrently from several threads
+
+    // Gradient given by its components
+    GradientFunction fromComponents(Gradient grad, bool parallel = false);
+
+    // compute the Gradient using forward finite differences: n + 1 evaluations of f, which share f(x)
+    GradientFunction finiteDiff(Function f, unsigned size, bool parallel = false, Scalar h = 1e-5);
+
+    // compute the Gradient using central finite differences: 2n evaluations of f, error O(h^2)
+    GradientFunction centralDiff(Function f, unsigned size, bool parallel = false, Scalar h = 1e-5);
+
+    // compute the Gradient using the complex step Im(f(x + i h e_k)) / h: n evaluations of f on complex vectors,
+    // without cancellation so h can be tiny and the derivative is exact up to rounding for analytic f
+    GradientFunction complexStepDiff(ComplexFunction f, unsigned size, bool parallel = false, Scalar h = 1e-20);
     
-}
\ No newline at end of file
+}
+
+#endif
@@ -0,0 +1,80 @@
+#include "NewtonCG.hpp"
+#include <limits>
+
+namespace pacs{
+
+    std::vector<unsigned> colorColumns(const SparseMatrix & pattern)
+    {
+        const std::size_t n = pattern.get_columns();
+        const auto & offsets = pattern.get_offsets();
+        const auto & indices = pattern.get_indices();
+        const unsigned none = std::numeric_limits<unsigned>::max();
+
+        // forbidden[c] == j if color c is used by a column sharing a row with column j
+        std::vector<unsigned> color(n, none);
+        std::vector<std::size_t> forbidden;
+        for(std::size_t j = 0; j < n; ++j){
+            // The rows of column j are the columns of row j, the structure being symmetric
+            for(std::size_t a = offsets[j]; a < offsets[j + 1]; ++a){
+                const std::size_t i = indices[a];
+                for(std::size_t b = offsets[i]; b < offsets[i + 1]; ++b){
+                    if(color[indices[b]] != none){
+                        forbidden[color[indices[b]]] = j;
+                    }
+                }
+            }
+            unsigned c = 0;
+            while(c < forbidden.size() && forbidden[c] == j){
+                ++c;
+            }
+            if(c == forbidden.size()){
+                forbidden.push_back(n);
+            }
+            color[j] = c;
+        }
+        return color;
+    }
+
+    SparseHessianEstimator::SparseHessianEstimator(const SparseMatrix & pattern, Scalar step)
+        : h(step), xh(pattern.get_rows()), gh(pattern.get_rows())
+    {
+        const std::size_t n = pattern.get_rows();
+        const auto & offsets = pattern.get_offsets();
+        const auto & indices = pattern.get_indices();
+        std::vector<unsigned> color = colorColumns(pattern);
+        for(unsigned c : color){
+            nColors = std::max(nColors, c + 1);
+        }
+
+        // Bucket the columns and the non-zeros by color, as the offsets of a compressed matrix
+        columnOffsets.assign(nColors + 1, 0);
+        entryOffsets.assign(nColors + 1, 0);
+        for(std::size_t j = 0; j < n; ++j){
+            columnOffsets[color[j] + 1]++;
+        }
+        for(std::size_t k = 0; k < indices.size(); ++k){
+            entryOffsets[color[indices[k]] + 1]++;
+        }
+        for(unsigned c = 0; c < nColors; ++c){
+            columnOffsets[c + 1] += columnOffsets[c];
+            entryOffsets[c + 1] += entryOffsets[c];
+        }
+
+        std::vector<std::size_t> nextColumn(columnOffsets.begin(), columnOffsets.end() - 1);
+        std::vector<std::size_t> nextEntry(entryOffsets.begin(), entryOffsets.end() - 1);
+        columns.resize(n);
+        entries.resize(indices.size());
+        entryRows.resize(indices.size());
+        for(std::size_t j = 0; j < n; ++j){
+            columns[nextColumn[color[j]]++] = j;
+        }
+        for(std::size_t i = 0; i < n; ++i){
+            for(std::size_t k = offsets[i]; k < offsets[i + 1]; ++k){
+                const std::size_t position = nextEntry[color[indices[k]]]++;
+                entries[position] = k;
+                entryRows[position] = i;
+            }
+        }
+    }
+
+}
@@ -0,0 +1,275 @@
+#ifndef NEWTONCG_HPP
+#define NEWTONCG_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <optional>
+#include <utility>
+#include <vector>
+#include "GradientMethodEngine.hpp"
+#include "Matrix.hpp"
+
+// Truncated Newton (Newton-CG) method for objectives with a sparse Hessian, stored as a compressed
+// algebra::Matrix of Challenge-2. Each Newton step solves H p = -grad f only approximately with the
+// conjugate gradient, stopped on a relative residual that decreases with the gradient and at the first
+// direction of negative curvature, then p is line searched with the Armijo rule from alpha = 1.
+// The Hessian is given by the user or estimated from differences of the gradient along groups of
+// columns without common rows, found by coloring the sparsity pattern: colors + 1 gradients per
+// Hessian instead of n + 1
+
+namespace pacs{
+
+    using SparseMatrix = algebra::Matrix<Scalar, algebra::StorageOrder::ROWMAJOR>;
+
+    // Hessian at x written in the values of H, whose sparsity pattern does not change
+    using HessianFunction = std::function<void(const Vector &, SparseMatrix &)>;
+
+    // Parameters of the Newton-CG method
+    struct NewtonCGParameters
+    {
+        Scalar epsS;             // on the step length
+        Scalar epsR;             // on the change of f
+        Scalar epsG;             // on the norm of the gradient
+        unsigned maxIt;          // Newton steps
+        unsigned maxCG = 500;    // conjugate gradient iterations per Newton step
+        Scalar h = 1e-6;         // relative step of the finite difference Hessian
+    };
+
+    // Greedy coloring of the columns of a square compressed pattern with symmetric structure:
+    // columns with a non-zero in the same row get different colors (Curtis, Powell and Reid)
+    std::vector<unsigned> colorColumns(const SparseMatrix & pattern);
+
+    // Estimate of a sparse Hessian from differences of the gradient. The columns of a color have no
+    // common row, so one gradient at x + h * (sum of the columns of the color) gives all of them
+    class SparseHessianEstimator
+    {
+    public:
+        // pattern: square compressed pattern of the Hessian with symmetric structure, the diagonal included
+        SparseHessianEstimator(const SparseMatrix & pattern, Scalar h);
+
+        unsigned colors() const { return nColors; }
+
+        // Values of H at x, with the pattern given to the constructor, from g = grad(x)
+        template <typename G>
+        void estimate(G & grad, const Vector & x, const Vector & g, SparseMatrix & H)
+        {
+            auto values = H.get_mutable_values();
+            for(unsigned c = 0; c < nColors; ++c){
+                // Step relative to the size of the perturbed components
+                Scalar step = 0;
+                for(std::size_t k = columnOffsets[c]; k < columnOffsets[c + 1]; ++k){
+                    step = std::max(step, std::abs(x[columns[k]]));
+                }
+                step = h*(1 + step);
+
+                xh = x;
+                for(std::size_t k = columnOffsets[c]; k < columnOffsets[c + 1]; ++k){
+                    xh[columns[k]] += step;
+                }
+                grad(xh, gh);
+                for(std::size_t k = entryOffsets[c]; k < entryOffsets[c + 1]; ++k){
+                    values[entries[k]] = (gh[entryRows[k]] - g[entryRows[k]])/step;
+                }
+            }
+        }
+
+    private:
+        unsigned nColors = 0;
+        Scalar h;
+        // Columns of each color, and positions in the compressed values (with their row) of the non-zeros of
+        // the columns of each color
+        std::vector<std::size_t> columnOffsets;
+        std::vector<std::size_t> columns;
+        std::vector<std::size_t> entryOffsets;
+        std::vector<std::size_t> entries;
+        std::vector<std::size_t> entryRows;
+        Vector xh;
+        Vector gh;
+    };
+
+    // F: Scalar f(const Vector &x)
+    // G: void grad(const Vector &x, Vector &g), writes the whole gradient in g
+    template <typename F, typename G>
+    class NewtonCG
+    {
+    public:
+        // Hessian estimated by colored finite differences of the gradient on the pattern
+        NewtonCG(F fun, G gradient, const SparseMatrix & pattern, const NewtonCGParameters & parameters)
+            : f(std::move(fun)), grad(std::move(gradient)), params(parameters), H(pattern),
+              estimator(std::in_place, pattern, parameters.h)
+        {
+            allocate();
+        }
+
+        // Hessian given by the user on the pattern
+        NewtonCG(F fun, G gradient, HessianFunction hessianFunction, const SparseMatrix & pattern, const NewtonCGParameters & parameters)
+            : f(std::move(fun)), grad(std::move(gradient)), hessian(std::move(hessianFunction)), params(parameters), H(pattern)
+        {
+            allocate();
+        }
+
+        // Minimize starting from xInit and return the last iterate
+        const Vector & minimize(const Vector & xInit)
+        {
+            evaluations = {};
+            hessians = 0;
+            cgTotal = 0;
+            iter = 0;
+
+            x = xInit;
+            Scalar fx = value(x);
+            evalGradient(x);
+            gNorm = std::sqrt(dot(g, g));
+
+            while (gNorm > params.epsG && iter < params.maxIt)
+            {
+                evalHessian();
+                newtonDirection();
+
+                // Armijo rule along p from the Newton step
+                const Scalar delta = 1e-4;
+                const Scalar slope = dot(g, p);
+                Scalar alpha = 1;
+                Scalar fNew;
+                while (true)
+                {
+                    for(std::size_t i = 0; i < x.size(); ++i){
+                        xNew[i] = x[i] + alpha*p[i];
+                    }
+                    fNew = value(xNew);
+                    if(fx - fNew >= -delta*alpha*slope || alpha < 1e-12){
+                        break;
+                    }
+                    alpha = alpha/2;
+                }
+
+                const Scalar stepNorm = std::sqrt(squaredDistance(xNew, x));
+                const Scalar change = std::abs(fx - fNew);
+                std::swap(x, xNew);
+                fx = fNew;
+                evalGradient(x);
+                gNorm = std::sqrt(dot(g, g));
+                ++iter;
+
+                if(stepNorm < params.epsS || change < params.epsR){
+                    break;
+                }
+            }
+
+            fMin = fx;
+            return x;
+        }
+
+        // Newton steps of the last minimization
+        unsigned iterations() const { return iter; }
+
+        // Conjugate gradient iterations of the last minimization
+        unsigned long cgIterations() const { return cgTotal; }
+
+        // Evaluations of the function and of the gradient, those of the finite difference Hessian included
+        const EvaluationCounters & counters() const { return evaluations; }
+
+        // Hessians computed in the last minimization
+        unsigned long hessianEvaluations() const { return hessians; }
+
+        // Colors of the pattern, gradients per finite difference Hessian; 0 with a given Hessian
+        unsigned colors() const { return estimator ? estimator->colors() : 0; }
+
+        // Value of f and norm of the gradient at the last iterate
+        Scalar minValue() const { return fMin; }
+        Scalar gradientNorm() const { return gNorm; }
+
+    private:
+        F f;
+        G grad;
+        HessianFunction hessian;
+        NewtonCGParameters params;
+
+        SparseMatrix H;
+        std::optional<SparseHessianEstimator> estimator;
+
+        // Iterate, candidate point, gradient, Newton direction and vectors of the conjugate gradient
+        Vector x, xNew, g, p, r, d, q;
+        Scalar fMin = 0;
+        Scalar gNorm = 0;
+        unsigned iter = 0;
+        unsigned long cgTotal = 0;
+        unsigned long hessians = 0;
+        EvaluationCounters evaluations;
+
+        void allocate()
+        {
+            const std::size_t n = H.get_rows();
+            for(Vector *v : {&x, &xNew, &g, &p, &r, &d, &q}){
+                v->resize(n);
+            }
+        }
+
+        Scalar value(const Vector & y)
+        {
+            ++evaluations.f;
+            return f(y);
+        }
+
+        void evalGradient(const Vector & y)
+        {
+            grad(y, g);
+            ++evaluations.grad;
+        }
+
+        void evalHessian()
+        {
+            ++hessians;
+            if(estimator){
+                auto counted = [this](const Vector & y, Vector & gy){ grad(y, gy); ++evaluations.grad; };
+                estimator->estimate(counted, x, g, H);
+            }
+            else{
+                hessian(x, H);
+            }
+        }
+
+        // p ~ -H^-1 g by the conjugate gradient from p = 0, up to the relative residual min(0.5, sqrt|g|),
+        // which gives superlinear convergence. At a direction of negative curvature it stops, with the
+        // steepest descent direction if it is the first one
+        void newtonDirection()
+        {
+            const Scalar tolerance = std::min(0.5, std::sqrt(gNorm))*gNorm;
+            std::fill(p.begin(), p.end(), 0);
+            for(std::size_t i = 0; i < g.size(); ++i){
+                r[i] = -g[i];
+            }
+            d = r;
+            Scalar rr = gNorm*gNorm;
+
+            for(unsigned k = 0; k < params.maxCG; ++k)
+            {
+                ++cgTotal;
+                const Scalar curvature = H.multiply_dot(d, q, d);
+                if(curvature <= 0){
+                    if(k == 0){
+                        p = r;
+                    }
+                    return;
+                }
+                const Scalar a = rr/curvature;
+                axpy(a, d, p);
+                axpy(-a, q, r);
+                const Scalar rrNew = dot(r, r);
+                if(std::sqrt(rrNew) <= tolerance){
+                    return;
+                }
+                const Scalar b = rrNew/rr;
+                rr = rrNew;
+                for(std::size_t i = 0; i < d.size(); ++i){
+                    d[i] = r[i] + b*d[i];
+                }
+            }
+        }
+    };
+
+}
+
+#endif
@@ -4,6 +4,7 @@
 #include <functional>
 #include "GradientMethodUtils.hpp"
 #include "GradientMethod.hpp"
+#include "GradientMethodTrace.hpp"
 
 using namespace pacs;
 
@@ -11,15 +12,17 @@ int main()
 {
   
   // Define function and gradient
-  Function fun = [](Vector x) -> Scalar {return x[0]*x[1] + 4*std::pow(x[0],4) + std::pow(x[1],2) + 3*x[0];};
+  Function fun = [](const Vector &x) -> Scalar {return x[0]*x[1] + 4*std::pow(x[0],4) + std::pow(x[1],2) + 3*x[0];};
   
-  Gradient funGrad = {
-    [](Vector x){return x[1] + 16*std::pow(x[0], 3) + 3;},
-    [](Vector x){return x[0] + 2*x[1];} 
-                    };
+  // The gradient writes all its components in g
+  GradientFunction funGrad = [](const Vector &x, Vector &g){
+    g[0] = x[1] + 16*std::pow(x[0], 3) + 3;
+    g[1] = x[0] + 2*x[1];
+  };
 
   // Alternatively you can compute the gradient autoatically using finite difference
-  Gradient diff = finiteDiff(fun, 2);
+  // (or centralDiff, complexStepDiff, or fromComponents for a Gradient given by its components)
+  GradientFunction diff = finiteDiff(fun, 2);
 
   // Define data for the Gradient method
   GradientMethodData data = {
@@ -33,8 +36,14 @@ int main()
     'a'  // select the update rule for alpha - see GradientMethodData.hpp for detail
   };
 
-  // Compute the minimum using Gradient methid
-  Vector min  = gradientMethod(data);
+  // Compute the minimum using Gradient methid, recording the iterations in a trace
+  // (gradientMethod(data) alone does not record them)
+  TraceSink trace(data.maxIt);
+  EvaluationCounters counters;
+  Vector min  = gradientMethod(data, counters, &trace);
+
+  // Print the trace after the run, as CSV (or as JSON with writeJson)
+  trace.writeCsv(std::cout);
 
   // Print the minimum
   std::cout<<"MIN:"<<std::endl;
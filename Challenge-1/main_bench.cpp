@@ -0,0 +1,504 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <random>
+#include <string>
+#include <type_traits>
+#include "AutoDiff.hpp"
+#include "GradientMethod.hpp"
+#include "GradientMethodBatch.hpp"
+#include "GradientMethodEngine.hpp"
+#include "GradientMethodTrace.hpp"
+#include "NewtonCG.hpp"
+
+using namespace pacs;
+
+// Heap allocations made by the program, counted by the global operator new
+static unsigned long allocations = 0;
+
+void *operator new(std::size_t size)
+{
+    ++allocations;
+    if(void *p = std::malloc(size > 0 ? size : 1)){
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+// Not inlined, so that the compiler does not match the free with a call of the builtin operator new
+[[gnu::noinline]] void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+[[gnu::noinline]] void operator delete(void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+// The gradient method as it was before the engine, on a Gradient given by its components, without the
+// printing in the loop: every stage allocates its vectors and evaluates the gradient again
+namespace legacy{
+    bool verifyCondition(const Vector & oldX, const Vector & newX, const Function & f, const GradientMethodParameters & params)
+    {
+        Vector tmp = subVector(newX, oldX);
+        if(euclideanNorm(tmp) < params.epsS){
+            return false;
+        }
+        return std::abs(f(newX) - f(oldX)) >= params.epsR;
+    }
+
+    Scalar armijoRule(const Vector & oldX, const Function & f, const Gradient & grad, const GradientMethodParameters & params)
+    {
+        Scalar delta = 0.05;
+        Scalar alpha0 = params.alpha0;
+
+        Vector tmp = subVector(oldX, scalarGradProd(alpha0, grad, oldX));
+        Scalar norm = euclideanNorm(scalarGradProd(1.0, grad, oldX));
+        Scalar cond = delta*alpha0*std::pow(norm, 2);
+
+        while ( (f(oldX) - f(tmp)) < cond)
+        {
+            alpha0 = alpha0/2;
+            tmp = subVector(oldX, scalarGradProd(alpha0, grad, oldX));
+            norm = euclideanNorm(scalarGradProd(1.0, grad, oldX));
+            cond = delta*alpha0*std::pow(norm, 2);
+        }
+
+        return alpha0;
+    }
+
+    Vector gradientMethod(const Function & f, const Gradient & grad, const Vector & xInit, const GradientMethodParameters & params)
+    {
+        Vector oldX = xInit;
+        Vector newX = subVector(oldX, scalarGradProd(params.alpha0, grad, oldX));
+        unsigned iter = 0;
+
+        while (verifyCondition(oldX, newX, f, params) && iter < params.maxIt)
+        {
+            oldX = newX;
+            Scalar newAlpha = armijoRule(oldX, f, grad, params);
+            newX = subVector(oldX, scalarGradProd(newAlpha, grad, oldX));
+            ++iter;
+        }
+
+        return newX;
+    }
+
+    // Gradient by forward differences, one function per component, each evaluating f(x) again
+    Gradient finiteDiff(Function f, unsigned size)
+    {
+        Gradient grad;
+        const double h = 1e-5;
+        for (unsigned i = 0; i < size; ++i) {
+            grad.push_back([f, h, i](Vector x) -> Scalar {
+                Vector x_plus = x;
+                x_plus[i] += h;
+                return (f(x_plus) - f(x)) / (h);
+            });
+        }
+        return grad;
+    }
+}
+
+// Repeat a minimization and print time per run, evaluations per run and per second and allocations per run
+template <typename Run>
+void timeRuns(const std::string &name, unsigned runs, const EvaluationCounters &counters, Run &&run)
+{
+    Scalar checksum = 0;
+    unsigned long startAllocations = allocations;
+    auto start = std::chrono::high_resolution_clock::now();
+    for(unsigned r = 0; r < runs; ++r){
+        checksum += run();
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    double seconds = std::chrono::duration<double>(end - start).count();
+
+    std::cout<<name<<": "<<seconds/runs*1e6<<" microseconds per run, "
+             <<double(counters.f)/runs<<" f and "<<double(counters.grad)/runs<<" gradient evaluations per run, "
+             <<counters.f/seconds/1e6<<" M f evaluations/s, "
+             <<double(allocations - startAllocations)/runs<<" allocations per run"
+             <<" (min "<<checksum/runs<<")"<<std::endl;
+}
+
+// Function of main.cpp, minimized with the Armijo rule by the three implementations
+void benchmarkMain(unsigned runs)
+{
+    std::cout<<"f(x) = x0*x1 + 4*x0^4 + x1^2 + 3*x0:"<<std::endl;
+    GradientMethodParameters params = {1e-6, 1e-6, 0.1, 1000, 'a'};
+
+    EvaluationCounters legacyCounters;
+    Function legacyF = [&legacyCounters](Vector x) -> Scalar {++legacyCounters.f; return x[0]*x[1] + 4*std::pow(x[0],4) + std::pow(x[1],2) + 3*x[0];};
+    Gradient legacyGrad = {
+        [&legacyCounters](Vector x){++legacyCounters.grad; return x[1] + 16*std::pow(x[0], 3) + 3;},
+        [](Vector x){return x[0] + 2*x[1];}
+    };
+    timeRuns("legacy (std::function)", runs, legacyCounters, [&](){ return legacy::gradientMethod(legacyF, legacyGrad, {0, 0}, params)[0]; });
+
+    EvaluationCounters dynamicCounters;
+    Function f = [&dynamicCounters](const Vector &x) -> Scalar {++dynamicCounters.f; return x[0]*x[1] + 4*std::pow(x[0],4) + std::pow(x[1],2) + 3*x[0];};
+    auto grad = [&dynamicCounters](const Vector &x, Vector &g){
+        ++dynamicCounters.grad;
+        g[0] = x[1] + 16*x[0]*x[0]*x[0] + 3;
+        g[1] = x[0] + 2*x[1];
+    };
+    GradientMethodEngine<Function, decltype(grad)> dynamicEngine(f, grad, params, 2);
+    Vector xInit = {0, 0};
+    timeRuns("engine, std::function and std::vector", runs, dynamicCounters, [&](){ return dynamicEngine.minimize(xInit)[0]; });
+
+    EvaluationCounters fixedCounters;
+    auto fixedF = [&fixedCounters](const std::array<Scalar, 2> &x){++fixedCounters.f; return x[0]*x[1] + 4*x[0]*x[0]*x[0]*x[0] + x[1]*x[1] + 3*x[0];};
+    auto fixedGrad = [&fixedCounters](const std::array<Scalar, 2> &x, std::array<Scalar, 2> &g){
+        ++fixedCounters.grad;
+        g[0] = x[1] + 16*x[0]*x[0]*x[0] + 3;
+        g[1] = x[0] + 2*x[1];
+    };
+    GradientMethodEngine<decltype(fixedF), decltype(fixedGrad), 2> fixedEngine(fixedF, fixedGrad, params);
+    timeRuns("engine, lambdas and std::array", runs, fixedCounters, [&](){ return fixedEngine.minimize({0, 0})[0]; });
+}
+
+// Quadratic f(x) = sum (i + 1) x_i^2 / 2 of dimension N
+template <std::size_t N>
+void benchmarkQuadratic(unsigned runs)
+{
+    std::cout<<"Quadratic of dimension "<<N<<":"<<std::endl;
+    GradientMethodParameters params = {1e-6, 1e-6, 0.1, 1000, 'a'};
+
+    EvaluationCounters legacyCounters;
+    Gradient legacyGrad;
+    for(std::size_t i = 0; i < N; ++i){
+        legacyGrad.push_back([&legacyCounters, i](Vector x) -> Scalar {legacyCounters.grad += (i == 0); return (i + 1)*x[i];});
+    }
+    Function legacyF = [&legacyCounters](Vector x) -> Scalar {
+        ++legacyCounters.f;
+        Scalar sum = 0;
+        for(std::size_t i = 0; i < x.size(); ++i){ sum += (i + 1)*x[i]*x[i]/2; }
+        return sum;
+    };
+    timeRuns("legacy (std::function)", runs, legacyCounters, [&](){ return legacy::gradientMethod(legacyF, legacyGrad, Vector(N, 1.0), params)[0]; });
+
+    EvaluationCounters fixedCounters;
+    auto f = [&fixedCounters](const std::array<Scalar, N> &x){
+        ++fixedCounters.f;
+        Scalar sum = 0;
+        for(std::size_t i = 0; i < N; ++i){ sum += (i + 1)*x[i]*x[i]/2; }
+        return sum;
+    };
+    auto grad = [&fixedCounters](const std::array<Scalar, N> &x, std::array<Scalar, N> &g){
+        ++fixedCounters.grad;
+        for(std::size_t i = 0; i < N; ++i){ g[i] = (i + 1)*x[i]; }
+    };
+    GradientMethodEngine<decltype(f), decltype(grad), N> engine(f, grad, params);
+    std::array<Scalar, N> xInit;
+    xInit.fill(1.0);
+    timeRuns("engine, lambdas and std::array", runs, fixedCounters, [&](){ return engine.minimize(xInit)[0]; });
+}
+
+// Extended Rosenbrock function, for real and complex vectors
+auto rosenbrock = [](const auto &x){
+    typename std::decay_t<decltype(x)>::value_type sum = 0;
+    for(std::size_t i = 0; i + 1 < x.size(); ++i){
+        sum += 100.0*(x[i + 1] - x[i]*x[i])*(x[i + 1] - x[i]*x[i]) + (1.0 - x[i])*(1.0 - x[i]);
+    }
+    return sum;
+};
+
+void rosenbrockGradient(const Vector &x, Vector &g)
+{
+    std::fill(g.begin(), g.end(), 0.0);
+    for(std::size_t i = 0; i + 1 < x.size(); ++i){
+        g[i] += -400*x[i]*(x[i + 1] - x[i]*x[i]) - 2*(1 - x[i]);
+        g[i + 1] += 200*(x[i + 1] - x[i]*x[i]);
+    }
+}
+
+// Time per gradient, evaluations of f per gradient and largest error of the finite difference and AD gradients
+void benchmarkGradient(std::size_t n, unsigned runs)
+{
+    std::cout<<"Gradient of the Rosenbrock function of dimension "<<n<<":"<<std::endl;
+    Vector x(n), g(n), exact(n);
+    for(std::size_t i = 0; i < n; ++i){
+        x[i] = 0.5 + 0.01*i;
+    }
+    rosenbrockGradient(x, exact);
+
+    std::atomic<unsigned long> evaluations = 0;
+    auto counted = [&evaluations](const auto &x){ ++evaluations; return rosenbrock(x); };
+    Function f = counted;
+    ComplexFunction complexF = counted;
+
+    auto time = [&](const std::string &name, auto &&gradient){
+        gradient(x, g);
+        evaluations = 0;
+        auto start = std::chrono::high_resolution_clock::now();
+        for(unsigned r = 0; r < runs; ++r){
+            gradient(x, g);
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        Scalar error = 0;
+        for(std::size_t i = 0; i < n; ++i){
+            error = std::max(error, std::abs(g[i] - exact[i]));
+        }
+        std::cout<<name<<": "<<std::chrono::duration<double, std::micro>(end - start).count()/runs<<" microseconds, "
+                 <<double(evaluations)/runs<<" evaluations, error "<<error<<std::endl;
+    };
+
+    time("components, forward differences", fromComponents(legacy::finiteDiff(f, n)));
+    time("forward differences", finiteDiff(f, n));
+    time("central differences", centralDiff(f, n));
+    time("complex step", complexStepDiff(complexF, n));
+    time("forward mode AD", forwardGradient(counted, n));
+    time("reverse mode AD", reverseGradient(counted, n));
+#ifdef PARALLELEXEC
+    time("forward differences, parallel", finiteDiff(f, n, true));
+    time("complex step, parallel", complexStepDiff(complexF, n, true));
+#endif
+}
+
+// Cost of observing the iterations: nothing, printing the step with std::endl as the wrapper did, recording a trace
+void benchmarkTrace(unsigned runs)
+{
+    std::cout<<"Observers on f(x) = x0*x1 + 4*x0^4 + x1^2 + 3*x0:"<<std::endl;
+    EvaluationCounters counters;
+    Function f = [&counters](const Vector &x) -> Scalar {++counters.f; return x[0]*x[1] + 4*std::pow(x[0],4) + std::pow(x[1],2) + 3*x[0];};
+    auto grad = [&counters](const Vector &x, Vector &g){
+        ++counters.grad;
+        g[0] = x[1] + 16*x[0]*x[0]*x[0] + 3;
+        g[1] = x[0] + 2*x[1];
+    };
+    GradientMethodEngine<Function, decltype(grad)> engine(f, grad, {1e-6, 1e-6, 0.1, 1000, 'a'}, 2);
+    Vector xInit = {0, 0};
+
+    timeRuns("no observer", runs, counters, [&](){ return engine.minimize(xInit)[0]; });
+
+    std::ofstream null("/dev/null");
+    counters = {};
+    timeRuns("printing with std::endl", runs, counters, [&](){
+        return engine.minimize(xInit, [&null](unsigned, Scalar alpha){ null<<alpha<<std::endl; })[0];
+    });
+
+    TraceSink trace(1000);
+    counters = {};
+    timeRuns("trace sink", runs, counters, [&](){
+        trace.clear();
+        return engine.minimize(xInit, trace)[0];
+    });
+    std::cout<<trace.size()<<" iterations recorded"<<std::endl;
+}
+
+// Iterations, evaluations, time and final value of each strategy minimizing f from xInit, alpha0 is tuned for each one
+template <typename F, typename G>
+void compareStrategies(const std::string &name, F f, G grad, const Vector &xInit, const std::vector<std::pair<char, Scalar>> &strategies)
+{
+    std::cout<<name<<":"<<std::endl;
+    for(const auto &[strategy, alpha0] : strategies){
+        GradientMethodEngine<F, G> engine(f, grad, {1e-10, 1e-14, alpha0, 100000, strategy}, xInit.size());
+        auto start = std::chrono::high_resolution_clock::now();
+        engine.minimize(xInit);
+        auto end = std::chrono::high_resolution_clock::now();
+        std::cout<<"'"<<strategy<<"', alpha0 "<<alpha0<<": "<<engine.iterations()<<" iterations, "
+                 <<engine.counters().f<<" f and "<<engine.counters().grad<<" gradient evaluations, "
+                 <<std::chrono::duration<double, std::milli>(end - start).count()<<" ms, f "<<engine.minValue()<<std::endl;
+    }
+}
+
+// Steepest descent with the Armijo rule against the accelerated strategies
+void benchmarkStrategies()
+{
+    auto rosenbrockF = [](const Vector &x){ return rosenbrock(x); };
+    compareStrategies("Strategies on the Rosenbrock function of dimension 10", rosenbrockF, rosenbrockGradient, Vector(10, -1.0),
+                      {{'a', 1e-3}, {'m', 2e-4}, {'n', 2e-4}, {'d', 1e-2}, {'l', 1}});
+
+    // Quadratic f(x) = sum (i + 1) x_i^2 / 2, whose condition number is the dimension n
+    auto quadratic = [](const Vector &x){
+        Scalar sum = 0;
+        for(std::size_t i = 0; i < x.size(); ++i){ sum += (i + 1)*x[i]*x[i]/2; }
+        return sum;
+    };
+    auto quadraticGradient = [](const Vector &x, Vector &g){
+        for(std::size_t i = 0; i < x.size(); ++i){ g[i] = (i + 1)*x[i]; }
+    };
+    for(std::size_t n : {10, 100, 1000}){
+        const Scalar step = 1.0/n; // 1 / L
+        compareStrategies("Strategies on the quadratic of dimension " + std::to_string(n), quadratic, quadraticGradient, Vector(n, 1.0),
+                          {{'a', 1}, {'m', step}, {'n', step}, {'d', 1e-2}, {'l', 1}});
+    }
+}
+
+// Sparse objective: f, gradient, Hessian and its pattern
+struct SparseProblem
+{
+    std::string name;
+    std::function<Scalar(const Vector &)> f;
+    std::function<void(const Vector &, Vector &)> grad;
+    HessianFunction hessian;
+    SparseMatrix pattern;
+};
+
+// Quadratic x^T A x / 2 - sum x of dimension n, A = tridiag(-1, 2 + s_i, -1) with s_i in [0.01, 0.61]
+SparseProblem sparseQuadratic(std::size_t n)
+{
+    auto shift = [](std::size_t i){ return 0.01 + 0.1*(i % 7); };
+    auto product = [n, shift](const Vector &x, std::size_t i){
+        return (2 + shift(i))*x[i] - (i > 0 ? x[i - 1] : 0) - (i + 1 < n ? x[i + 1] : 0);
+    };
+    SparseMatrix pattern(n, n);
+    for(std::size_t i = 0; i < n; ++i){
+        for(std::size_t j = (i > 0 ? i - 1 : 0); j < std::min(n, i + 2); ++j){
+            pattern.add(i, j, 0);
+        }
+    }
+    pattern.compress();
+    return {"sparse quadratic of dimension " + std::to_string(n),
+            [product](const Vector &x){
+                Scalar sum = 0;
+                for(std::size_t i = 0; i < x.size(); ++i){ sum += x[i]*product(x, i)/2 - x[i]; }
+                return sum;
+            },
+            [product](const Vector &x, Vector &g){
+                for(std::size_t i = 0; i < x.size(); ++i){ g[i] = product(x, i) - 1; }
+            },
+            [n, shift](const Vector &, SparseMatrix &H){
+                for(std::size_t i = 0; i < n; ++i){
+                    for(std::size_t j = (i > 0 ? i - 1 : 0); j < std::min(n, i + 2); ++j){
+                        H.update(i, j, i == j ? 2 + shift(i) : -1);
+                    }
+                }
+            },
+            pattern};
+}
+
+// Energy of the nonlinear Poisson problem -laplace(u) + u^3 = 1 on the unit square with u = 0 on the boundary,
+// finite differences on m x m interior points: u^T L u / 2 + h^2 sum (u^4 / 4 - u), L the 5-point Laplacian
+SparseProblem poissonEnergy(std::size_t m)
+{
+    const std::size_t n = m*m;
+    const Scalar h2 = 1.0/((m + 1)*(m + 1));
+    // (L u)_k, the missing neighbours on the boundary are 0
+    auto laplacian = [m](const Vector &u, std::size_t k){
+        const std::size_t i = k / m, j = k % m;
+        Scalar sum = 4*u[k];
+        if(i > 0){ sum -= u[k - m]; }
+        if(i + 1 < m){ sum -= u[k + m]; }
+        if(j > 0){ sum -= u[k - 1]; }
+        if(j + 1 < m){ sum -= u[k + 1]; }
+        return sum;
+    };
+    auto neighbours = [m](std::size_t k){
+        const std::size_t i = k / m, j = k % m;
+        std::vector<std::size_t> result;
+        if(i > 0){ result.push_back(k - m); }
+        if(j > 0){ result.push_back(k - 1); }
+        result.push_back(k);
+        if(j + 1 < m){ result.push_back(k + 1); }
+        if(i + 1 < m){ result.push_back(k + m); }
+        return result;
+    };
+    SparseMatrix pattern(n, n);
+    for(std::size_t k = 0; k < n; ++k){
+        for(std::size_t l : neighbours(k)){
+            pattern.add(k, l, 0);
+        }
+    }
+    pattern.compress();
+    return {"Poisson energy on a " + std::to_string(m) + " x " + std::to_string(m) + " grid",
+            [laplacian, h2](const Vector &u){
+                Scalar sum = 0;
+                for(std::size_t k = 0; k < u.size(); ++k){ sum += u[k]*laplacian(u, k)/2 + h2*(u[k]*u[k]*u[k]*u[k]/4 - u[k]); }
+                return sum;
+            },
+            [laplacian, h2](const Vector &u, Vector &g){
+                for(std::size_t k = 0; k < u.size(); ++k){ g[k] = laplacian(u, k) + h2*(u[k]*u[k]*u[k] - 1); }
+            },
+            [n, m, h2](const Vector &u, SparseMatrix &H){
+                auto values = H.get_mutable_values();
+                const auto &offsets = H.get_offsets();
+                const auto &indices = H.get_indices();
+                for(std::size_t k = 0; k < n; ++k){
+                    for(std::size_t a = offsets[k]; a < offsets[k + 1]; ++a){
+                        values[a] = (indices[a] == k) ? 4 + 3*h2*u[k]*u[k] : -1;
+                    }
+                }
+            },
+            pattern};
+}
+
+// Newton-CG, with the colored finite difference Hessian and with the exact one, against steepest descent and L-BFGS
+void benchmarkNewton(const SparseProblem &problem)
+{
+    const std::size_t n = problem.pattern.get_rows();
+    std::cout<<"Newton-CG on the "<<problem.name<<":"<<std::endl;
+    Vector xInit(n, 0.0), g(n);
+
+    auto report = [&](const std::string &name, auto &&minimize, auto &&describe){
+        auto start = std::chrono::high_resolution_clock::now();
+        const Vector &x = minimize();
+        auto end = std::chrono::high_resolution_clock::now();
+        problem.grad(x, g);
+        std::cout<<name<<": "<<describe()<<", "<<std::chrono::duration<double, std::milli>(end - start).count()
+                 <<" ms, f "<<problem.f(x)<<", |grad f| "<<std::sqrt(dot(g, g))<<std::endl;
+    };
+
+    for(char strategy : {'a', 'l'}){
+        GradientMethodEngine<Function, GradientFunction> engine(problem.f, problem.grad, {1e-14, 1e-16, 1, 20000, strategy}, n);
+        report(strategy == 'a' ? "steepest descent, Armijo" : "L-BFGS", [&]() -> const Vector & { return engine.minimize(xInit); }, [&](){
+            return std::to_string(engine.iterations()) + " iterations, " + std::to_string(engine.counters().f) + " f and "
+                   + std::to_string(engine.counters().grad) + " gradient evaluations";
+        });
+    }
+
+    NewtonCGParameters params = {1e-14, 1e-16, 1e-10, 100};
+    NewtonCG<Function, GradientFunction> estimated(problem.f, problem.grad, problem.pattern, params);
+    NewtonCG<Function, GradientFunction> exact(problem.f, problem.grad, problem.hessian, problem.pattern, params);
+    for(auto *newton : {&estimated, &exact}){
+        report(newton == &estimated ? "Newton-CG, " + std::to_string(newton->colors()) + " colors" : "Newton-CG, exact Hessian",
+               [&]() -> const Vector & { return newton->minimize(xInit); }, [&](){
+            return std::to_string(newton->iterations()) + " iterations, " + std::to_string(newton->cgIterations()) + " CG iterations, "
+                   + std::to_string(newton->counters().f) + " f and " + std::to_string(newton->counters().grad) + " gradient evaluations";
+        });
+    }
+}
+
+// Multi-start minimization of the Rosenbrock function of dimension n, with reverse mode gradients
+void benchmarkBatch(std::size_t n, std::size_t runs)
+{
+    std::cout<<"Multi-start on the Rosenbrock function of dimension "<<n<<", "<<runs<<" starting points:"<<std::endl;
+    GradientMethodData data = {rosenbrock, reverseGradient(rosenbrock, n), Vector(n), 1e-10, 1e-12, 1e-2, 20000, 'a'};
+
+    std::mt19937 engine(1);
+    std::uniform_real_distribution<Scalar> distribution(-2, 2);
+    std::vector<Vector> starts(runs, Vector(n));
+    for(auto &x : starts){
+        for(auto &xi : x){
+            xi = distribution(engine);
+        }
+    }
+
+    BatchStatistics statistics;
+    std::vector<GradientMethodResult> results = multiStart(data, starts, statistics);
+    std::cout<<"wall time "<<statistics.wallTime*1e3<<" ms, sum of the runs "<<statistics.meanTime*statistics.runs*1e3<<" ms, "
+             <<statistics.converged<<" converged, iterations "<<statistics.minIterations<<" - "<<statistics.meanIterations
+             <<" - "<<statistics.maxIterations<<", "<<statistics.fEvaluations<<" f and "<<statistics.gradEvaluations
+             <<" gradient evaluations, best f "<<results[statistics.best].value<<std::endl;
+}
+
+int main()
+{
+    benchmarkMain(2000);
+    benchmarkQuadratic<10>(200);
+    for(std::size_t n : {10, 100, 1000}){
+        benchmarkGradient(n, 10000/n);
+    }
+    benchmarkTrace(2000);
+    benchmarkStrategies();
+    benchmarkBatch(4, 200);
+    benchmarkNewton(sparseQuadratic(10000));
+    benchmarkNewton(poissonEnergy(100));
+}
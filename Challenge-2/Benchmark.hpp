@@ -0,0 +1,576 @@
+#ifndef BENCHMARK_HPP
+#define BENCHMARK_HPP
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Matrix.hpp"
+#include "Reordering.hpp"
+
+namespace algebra
+{
+
+    /*!
+     * Settings shared by all the benchmarks
+     */
+    struct BenchmarkOptions
+    {
+        std::size_t warmup = 2;          // untimed runs before the samples
+        std::size_t repetitions = 11;    // number of samples
+        double min_sample_time = 1e6;    // nanoseconds, fast operations are repeated in each sample up to this time
+        std::size_t n_threads = 1;       // threads of the matrices
+        std::size_t n_accesses = 100000; // element accesses in each sample of the random access benchmark
+    };
+
+    /*!
+     * Distribution of the samples of a benchmark, in nanoseconds per call
+     */
+    struct BenchmarkStatistics
+    {
+        std::size_t samples = 0;
+        double min = 0;
+        double p10 = 0;
+        double median = 0;
+        double p90 = 0;
+        double max = 0;
+    };
+
+    /*!
+     * Result of a benchmark. flops and bytes are the floating point operations and the minimum memory traffic
+     * of a call, items the elements processed by a call (entries, non-zero elements or accesses)
+     */
+    struct BenchmarkRecord
+    {
+        std::string matrix;
+        std::string order;
+        std::string operation;
+        std::size_t n_threads = 1;
+        std::size_t n_rows = 0;
+        std::size_t n_columns = 0;
+        std::size_t nnz = 0;
+        std::size_t items = 0;
+        double flops = 0;
+        double bytes = 0;
+        BenchmarkStatistics time;
+
+        double gflops() const
+        {
+            return time.median > 0 ? flops / time.median : 0;
+        }
+
+        double bandwidth() const
+        {
+            return time.median > 0 ? bytes / time.median : 0;
+        }
+    };
+
+    /*!
+     * Collect the benchmark results, print them as a table while they are added and write them in CSV format
+     */
+    class BenchmarkReport
+    {
+    private:
+        std::vector<BenchmarkRecord> records;
+        bool header_printed = false;
+
+    public:
+        /*!
+         * Store a result and print it on the standard output
+         * @param record Result of a benchmark
+         */
+        void add(const BenchmarkRecord &record);
+
+        /*!
+         * Get the results added so far
+         */
+        const std::vector<BenchmarkRecord> &get_records() const
+        {
+            return records;
+        }
+
+        /*!
+         * Write the results in CSV format, one line per benchmark with times in nanoseconds,
+         * GFLOP/s and GB/s computed on the median time
+         * @param file_path Path of the file
+         * @return std::runtime_error if the file cannot be written
+         */
+        void write_csv(const std::string &file_path) const;
+    };
+
+    /*!
+     * Sort the samples and compute their statistics
+     * @param samples Times in nanoseconds
+     */
+    inline BenchmarkStatistics statistics(std::vector<double> samples)
+    {
+        BenchmarkStatistics result;
+        result.samples = samples.size();
+        if (samples.empty())
+        {
+            return result;
+        }
+
+        std::sort(samples.begin(), samples.end());
+        auto percentile = [&](double p)
+        {
+            // Linear interpolation between the closest ranks
+            double position = p * (samples.size() - 1);
+            std::size_t below = static_cast<std::size_t>(position);
+            std::size_t above = std::min(below + 1, samples.size() - 1);
+            return samples[below] + (position - below) * (samples[above] - samples[below]);
+        };
+
+        result.min = samples.front();
+        result.p10 = percentile(0.1);
+        result.median = percentile(0.5);
+        result.p90 = percentile(0.9);
+        result.max = samples.back();
+        return result;
+    }
+
+    /*!
+     * Time f(). After the warm-up runs, the number of calls per sample is chosen so that a sample
+     * lasts at least options.min_sample_time, and each sample is the average time of its calls
+     * @param f Operation to time
+     * @param options Number of warm-up runs and samples
+     */
+    template <typename Function>
+    BenchmarkStatistics measure(Function &&f, const BenchmarkOptions &options)
+    {
+        using clock = std::chrono::steady_clock;
+
+        auto time = [&](std::size_t n_calls)
+        {
+            auto start = clock::now();
+            for (std::size_t c = 0; c < n_calls; ++c)
+            {
+                f();
+            }
+            auto end = clock::now();
+            return std::chrono::duration<double, std::nano>(end - start).count() / n_calls;
+        };
+
+        double call_time = 0;
+        for (std::size_t w = 0; w < std::max<std::size_t>(1, options.warmup); ++w)
+        {
+            call_time = time(1);
+        }
+        std::size_t n_calls = std::max<std::size_t>(1, static_cast<std::size_t>(std::ceil(options.min_sample_time / std::max(call_time, 1.0))));
+
+        std::vector<double> samples(options.repetitions);
+        for (auto &sample : samples)
+        {
+            sample = time(n_calls);
+        }
+        return statistics(std::move(samples));
+    }
+
+    /*!
+     * Time f() when each call needs a fresh state: setup() runs untimed before each call of f()
+     * @param setup Untimed preparation of each call
+     * @param f Operation to time
+     * @param options Number of warm-up runs and samples
+     */
+    template <typename Setup, typename Function>
+    BenchmarkStatistics measure(Setup &&setup, Function &&f, const BenchmarkOptions &options)
+    {
+        using clock = std::chrono::steady_clock;
+
+        auto time = [&]()
+        {
+            setup();
+            auto start = clock::now();
+            f();
+            auto end = clock::now();
+            return std::chrono::duration<double, std::nano>(end - start).count();
+        };
+
+        for (std::size_t w = 0; w < options.warmup; ++w)
+        {
+            time();
+        }
+
+        std::vector<double> samples(options.repetitions);
+        for (auto &sample : samples)
+        {
+            sample = time();
+        }
+        return statistics(std::move(samples));
+    }
+
+    /*!
+     * Entries of a square banded matrix with 2 * half_band + 1 non-zero diagonals, ordered by row
+     * @param n Number of rows and columns
+     * @param half_band Number of diagonals above (and below) the main diagonal
+     */
+    inline std::vector<Triplet<double>> banded_entries(std::size_t n, std::size_t half_band)
+    {
+        std::vector<Triplet<double>> entries;
+        entries.reserve(n * (2 * half_band + 1));
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            std::size_t j_start = i > half_band ? i - half_band : 0;
+            std::size_t j_end = std::min(n, i + half_band + 1);
+            for (std::size_t j = j_start; j < j_end; ++j)
+            {
+                entries.push_back({i, j, (i == j) ? 2.0 * half_band + 1 : -1.0 / (1.0 + i + j)});
+            }
+        }
+        return entries;
+    }
+
+    /*!
+     * Entries of a square matrix with the same number of non-zero elements in each row, at uniformly random columns
+     * @param n Number of rows and columns
+     * @param row_length Number of entries of each row, repeated columns are summed by the assembly
+     * @param seed Seed of the random generator
+     */
+    inline std::vector<Triplet<double>> uniform_entries(std::size_t n, std::size_t row_length, std::uint64_t seed = 42)
+    {
+        std::mt19937_64 generator(seed);
+        std::uniform_int_distribution<std::size_t> column(0, n - 1);
+        std::uniform_real_distribution<double> value(-1.0, 1.0);
+
+        std::vector<Triplet<double>> entries;
+        entries.reserve(n * row_length);
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            for (std::size_t k = 0; k < row_length; ++k)
+            {
+                entries.push_back({i, column(generator), value(generator)});
+            }
+        }
+        return entries;
+    }
+
+    /*!
+     * Entries of a square matrix whose row lengths follow a Pareto (power-law) distribution,
+     * as in graphs: most rows are short and a few are very long. Columns are uniformly random
+     * @param n Number of rows and columns
+     * @param mean_length Average number of entries per row
+     * @param shape Exponent of the distribution, greater than 1; smaller values give longer rows
+     * @param seed Seed of the random generator
+     */
+    inline std::vector<Triplet<double>> power_law_entries(std::size_t n, std::size_t mean_length, double shape = 2.0, std::uint64_t seed = 42)
+    {
+        std::mt19937_64 generator(seed);
+        std::uniform_int_distribution<std::size_t> column(0, n - 1);
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        std::uniform_real_distribution<double> value(-1.0, 1.0);
+        const double min_length = mean_length * (shape - 1) / shape;
+
+        std::vector<Triplet<double>> entries;
+        entries.reserve(n * mean_length);
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            double length = min_length * std::pow(1.0 - uniform(generator), -1.0 / shape);
+            std::size_t row_length = std::clamp<std::size_t>(static_cast<std::size_t>(length), 1, n);
+            for (std::size_t k = 0; k < row_length; ++k)
+            {
+                entries.push_back({i, column(generator), value(generator)});
+            }
+        }
+        return entries;
+    }
+
+    /*!
+     * Entries of the 5-point Laplacian on a side x side grid, numbered row by row
+     * @param side Number of nodes on each side of the grid, the matrix has side * side rows
+     */
+    inline std::vector<Triplet<double>> grid_entries(std::size_t side)
+    {
+        std::vector<Triplet<double>> entries;
+        entries.reserve(5 * side * side);
+        for (std::size_t x = 0; x < side; ++x)
+        {
+            for (std::size_t y = 0; y < side; ++y)
+            {
+                std::size_t node = x * side + y;
+                entries.push_back({node, node, 4.0});
+                if (x > 0)
+                {
+                    entries.push_back({node, node - side, -1.0});
+                }
+                if (x + 1 < side)
+                {
+                    entries.push_back({node, node + side, -1.0});
+                }
+                if (y > 0)
+                {
+                    entries.push_back({node, node - 1, -1.0});
+                }
+                if (y + 1 < side)
+                {
+                    entries.push_back({node, node + 1, -1.0});
+                }
+            }
+        }
+        return entries;
+    }
+
+    /*!
+     * Renumber rows and columns of the entries of a square matrix with a random permutation,
+     * like a mesh whose nodes arrive in a poor order
+     * @param entries Entries to renumber
+     * @param n Number of rows and columns
+     * @param seed Seed of the random generator
+     */
+    inline std::vector<Triplet<double>> shuffle_entries(std::vector<Triplet<double>> entries, std::size_t n, std::uint64_t seed = 42)
+    {
+        std::vector<std::size_t> numbering(n);
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            numbering[i] = i;
+        }
+        std::mt19937_64 generator(seed);
+        std::shuffle(numbering.begin(), numbering.end(), generator);
+
+        for (auto &t : entries)
+        {
+            t.row = numbering[t.row];
+            t.column = numbering[t.column];
+        }
+        return entries;
+    }
+
+    /*!
+     * Time the matrix-vector multiplication y = A * x with the in-place multiply(), on the compressed
+     * or on the uncompressed storage
+     * @param report Report where the result is added
+     * @param name Name of the matrix in the report
+     * @param test_matrix Matrix to time
+     * @param options Benchmark settings
+     */
+    template <typename T, StorageOrder Order, typename Index, typename Storage>
+    void benchmark_multiply(BenchmarkReport &report, const std::string &name, const Matrix<T, Order, Index, Storage> &test_matrix, const BenchmarkOptions &options)
+    {
+        std::vector<T> x(test_matrix.get_columns(), 1);
+        std::vector<T> y(test_matrix.get_rows(), 0);
+
+        BenchmarkRecord record;
+        record.matrix = name;
+        record.order = Order == StorageOrder::ROWMAJOR ? "row" : "column";
+        record.operation = test_matrix.is_compressed() ? "spmv" : "spmv-uncompressed";
+        record.n_threads = test_matrix.get_threads();
+        record.n_rows = test_matrix.get_rows();
+        record.n_columns = test_matrix.get_columns();
+        if (test_matrix.is_compressed())
+        {
+            record.nnz = test_matrix.get_nnz();
+        }
+        else
+        {
+            // get_nnz() counts the compressed elements only
+            Matrix<T, Order, Index, Storage> compressed_copy = test_matrix;
+            compressed_copy.compress();
+            record.nnz = compressed_copy.get_nnz();
+        }
+        record.items = record.nnz;
+        record.flops = 2.0 * record.nnz;
+        if (test_matrix.is_compressed())
+        {
+            // Compressed arrays read once, x read and y written once
+            record.bytes = record.nnz * (sizeof(Index) + sizeof(Storage)) + test_matrix.get_offsets().size() * sizeof(Index) + (record.n_rows + record.n_columns) * sizeof(T);
+        }
+        record.time = measure([&]()
+                              { test_matrix.multiply(x, y); },
+                              options);
+        report.add(record);
+    }
+
+    /*!
+     * Reorder a square compressed matrix with reverse Cuthill-McKee, print the bandwidth before and after,
+     * and time the reordering and the matrix-vector multiplication before and after it. The reordered
+     * matrix is named name + "-rcm" in the report
+     * @param report Report where the results are added
+     * @param name Name of the matrix in the report
+     * @param test_matrix Compressed matrix, it is not modified
+     * @param options Benchmark settings
+     */
+    template <typename T, StorageOrder Order, typename Index, typename Storage>
+    void benchmark_reordering(BenchmarkReport &report, const std::string &name, const Matrix<T, Order, Index, Storage> &test_matrix, const BenchmarkOptions &options)
+    {
+        Matrix<T, Order, Index, Storage> reordered = test_matrix;
+        std::vector<std::size_t> permutation;
+
+        BenchmarkRecord record;
+        record.matrix = name;
+        record.order = Order == StorageOrder::ROWMAJOR ? "row" : "column";
+        record.operation = "rcm";
+        record.n_threads = test_matrix.get_threads();
+        record.n_rows = test_matrix.get_rows();
+        record.n_columns = test_matrix.get_columns();
+        record.nnz = test_matrix.get_nnz();
+        record.items = record.nnz;
+        record.time = measure([&]()
+                              { reordered = test_matrix; },
+                              [&]()
+                              { permutation = reverse_cuthill_mckee(reordered); reordered.permute(permutation); },
+                              options);
+
+        benchmark_multiply(report, name, test_matrix, options);
+        report.add(record);
+        benchmark_multiply(report, name + "-rcm", reordered, options);
+
+        std::cout << name << " bandwidth: " << test_matrix.get_bandwidth() << " before, "
+                  << reordered.get_bandwidth() << " after reverse Cuthill-McKee" << std::endl;
+    }
+
+    /*!
+     * Time assembly, compress, uncompress, random element access and matrix-vector multiplication of a square matrix
+     * @param report Report where the results are added
+     * @param name Name of the matrix in the report
+     * @param n Number of rows and columns
+     * @param entries Entries of the matrix, repeated entries are summed
+     * @param options Benchmark settings
+     */
+    template <StorageOrder Order, typename Index = std::uint32_t, typename Storage = double>
+    void benchmark_suite(BenchmarkReport &report, const std::string &name, std::size_t n, const std::vector<Triplet<double>> &entries, const BenchmarkOptions &options)
+    {
+        using MatrixType = Matrix<double, Order, Index, Storage>;
+        std::optional<MatrixType> matrix;
+
+        BenchmarkRecord record;
+        record.matrix = name;
+        record.order = Order == StorageOrder::ROWMAJOR ? "row" : "column";
+        record.n_threads = options.n_threads;
+        record.n_rows = n;
+        record.n_columns = n;
+
+        auto add_entries = [&]()
+        {
+            matrix.emplace(n, n);
+            matrix->set_threads(options.n_threads);
+            matrix->reserve(entries.size());
+            for (const auto &t : entries)
+            {
+                matrix->add(t.row, t.column, t.value);
+            }
+        };
+
+        // Assembly: from the entries to the compressed matrix
+        record.operation = "assembly";
+        record.items = entries.size();
+        record.time = measure([&]()
+                              { matrix.reset(); },
+                              [&]()
+                              { add_entries(); matrix->compress(); },
+                              options);
+        MatrixType compressed_matrix = *matrix;
+        record.nnz = compressed_matrix.get_nnz();
+        report.add(record);
+
+        // Compress: from the uncompressed storage, where the entries have already been merged
+        record.operation = "compress";
+        record.items = record.nnz;
+        record.time = measure([&]()
+                              { add_entries(); std::as_const(*matrix)(0, 0); },
+                              [&]()
+                              { matrix->compress(); },
+                              options);
+        report.add(record);
+
+        // Uncompress
+        record.operation = "uncompress";
+        record.time = measure([&]()
+                              { matrix = compressed_matrix; },
+                              [&]()
+                              { matrix->uncompress(); },
+                              options);
+        report.add(record);
+        matrix.reset();
+
+        // Random access: half of the positions hold a non-zero element, the other half are uniformly random
+        std::mt19937_64 generator(42);
+        std::uniform_int_distribution<std::size_t> entry(0, entries.size() - 1);
+        std::uniform_int_distribution<std::size_t> index(0, n - 1);
+        std::vector<std::array<std::size_t, 2>> positions(options.n_accesses);
+        for (std::size_t a = 0; a < positions.size(); ++a)
+        {
+            const auto &t = entries[entry(generator)];
+            positions[a] = (a % 2 == 0) ? std::array<std::size_t, 2>{t.row, t.column} : std::array<std::size_t, 2>{index(generator), index(generator)};
+        }
+        std::shuffle(positions.begin(), positions.end(), generator);
+
+        record.operation = "random-access";
+        record.items = positions.size();
+        double checksum = 0;
+        record.time = measure([&]()
+                              {
+            for (const auto &position : positions)
+            {
+                checksum += std::as_const(compressed_matrix)(position[0], position[1]);
+            } },
+                              options);
+        report.add(record);
+        if (std::isnan(checksum))
+        {
+            std::cout << "NaN checksum" << std::endl;
+        }
+
+        benchmark_multiply(report, name, compressed_matrix, options);
+    }
+
+    /*
+     * ***************************************************************************
+     * Definitions
+     * ***************************************************************************
+     */
+    inline void BenchmarkReport::add(const BenchmarkRecord &record)
+    {
+        if (!header_printed)
+        {
+            std::cout << std::left << std::setw(20) << "matrix" << std::setw(8) << "order" << std::setw(19) << "operation"
+                      << std::right << std::setw(8) << "threads" << std::setw(10) << "nnz"
+                      << std::setw(14) << "median [ns]" << std::setw(14) << "p10 [ns]" << std::setw(14) << "p90 [ns]"
+                      << std::setw(12) << "ns/item" << std::setw(10) << "GFLOP/s" << std::setw(8) << "GB/s" << std::endl;
+            header_printed = true;
+        }
+
+        std::cout << std::left << std::setw(20) << record.matrix << std::setw(8) << record.order << std::setw(19) << record.operation
+                  << std::right << std::setw(8) << record.n_threads << std::setw(10) << record.nnz
+                  << std::fixed << std::setprecision(0)
+                  << std::setw(14) << record.time.median << std::setw(14) << record.time.p10 << std::setw(14) << record.time.p90
+                  << std::setprecision(2) << std::setw(12) << (record.items > 0 ? record.time.median / record.items : 0.0)
+                  << std::setw(10) << record.gflops() << std::setw(8) << record.bandwidth()
+                  << std::defaultfloat << std::setprecision(6) << std::endl;
+
+        records.push_back(record);
+    }
+
+    inline void BenchmarkReport::write_csv(const std::string &file_path) const
+    {
+        std::ofstream file(file_path);
+        if (!file)
+        {
+            throw std::runtime_error("Cannot write file " + file_path);
+        }
+
+        file << "matrix,order,operation,threads,rows,columns,nnz,items,samples,min_ns,p10_ns,median_ns,p90_ns,max_ns,gflops,gbytes_per_second\n";
+        file << std::setprecision(10);
+        for (const auto &record : records)
+        {
+            file << record.matrix << ',' << record.order << ',' << record.operation << ',' << record.n_threads << ','
+                 << record.n_rows << ',' << record.n_columns << ',' << record.nnz << ',' << record.items << ','
+                 << record.time.samples << ',' << record.time.min << ',' << record.time.p10 << ','
+                 << record.time.median << ',' << record.time.p90 << ',' << record.time.max << ','
+                 << record.gflops() << ',' << record.bandwidth() << '\n';
+        }
+
+        if (!file)
+        {
+            throw std::runtime_error("Cannot write file " + file_path);
+        }
+    }
+}
+
+#endif
@@ -1,8 +1,25 @@
+#ifndef MATRIX_HPP
+#define MATRIX_HPP
+
 #include <map>
 #include <array>
 #include <vector>
+#include <utility>
+#include <algorithm>
+#include <string>
 #include <iostream>
 #include <fstream>
+#include <stdexcept>
+#include <cstring>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <span>
+#include <atomic>
+#include <variant>
+#include "Parallel.hpp"
+#include "Triplet.hpp"
+#include "MatrixIO.hpp"
 
 namespace algebra
 {
@@ -17,22 +34,133 @@ namespace algebra
     };
 
     /*!
-     *   @tparam T tyep of the element in the matrix
+     * Check that a permutation of 0, ..., n - 1 has size n and holds each index exactly once
+     * @param permutation New to old numbering
+     * @param n Size of the permuted matrix or vector
+     * @return std::runtime_error if it is not a permutation
+     */
+    inline void check_permutation(const std::vector<std::size_t> &permutation, std::size_t n)
+    {
+        if (permutation.size() != n)
+        {
+            throw std::runtime_error("Non comforming size for the permutation");
+        }
+        std::vector<bool> seen(n, false);
+        for (std::size_t p : permutation)
+        {
+            if (p >= n || seen[p])
+            {
+                throw std::runtime_error("Invalid permutation: index " + std::to_string(p) + (p >= n ? " out of range" : " repeated"));
+            }
+            seen[p] = true;
+        }
+    }
+
+    /*!
+     *   @tparam T tyep of the element in the matrix, used for the computations
      *   @tparam StorageOrder storage order of the matrix
+     *   @tparam Index type of the offsets and indices of the compressed storage, 32 bits halve the index traffic
+     *                 and are enough as long as dimensions and number of non-zeros are below 2^32
+     *   @tparam Storage type of the values of the compressed storage, e.g. float values with double computations
+     * The uncompressed and the compressed representations are distinct types held in a variant, so that only the
+     * one of the current state is alive, and the storage order is dispatched at compile time
      */
-    template <typename T, StorageOrder Order>
+    template <typename T, StorageOrder Order, typename Index = std::uint32_t, typename Storage = T>
     class Matrix
     {
 
     private:
-        std::map<std::array<std::size_t, 2>, T> uncompressed_data;
-        std::vector<T> compressed_data;
-        std::vector<std::size_t> offsets_vector;
-        std::vector<std::size_t> indices_vector;
+        static constexpr bool row_major = (Order == StorageOrder::ROWMAJOR);
+
+        /*!
+         * Uncompressed representation: entries set through operator() and entries appended through add(),
+         * the latter are merged into the map only when needed
+         */
+        struct Uncompressed
+        {
+            mutable std::map<std::array<std::size_t, 2>, T> data;
+            mutable std::vector<Triplet<T>> triplets;
+        };
+
+        /*!
+         * Compressed representation, CSR for ROWMAJOR and CSC for COLMAJOR. The rows (columns) of each thread, balanced by
+         * number of non-zeros, and the per-thread partial results of the scattering products and of multiply_dot() are set up
+         * by setup_threads() so that multiply() does not allocate
+         */
+        struct Compressed
+        {
+            std::vector<Storage> values;
+            std::vector<Index> offsets;
+            std::vector<Index> indices;
+            std::vector<std::size_t> thread_bounds;
+            mutable std::vector<T> workspace;
+            mutable std::vector<T> partial_dots;
+        };
+
+        std::variant<Uncompressed, Compressed> storage;
         std::size_t n_rows = 0;
         std::size_t n_columns = 0;
-        bool compressed = false;
-        T sparse_element = 0;
+        std::size_t n_threads = 1;
+
+        // Position of the last element accessed in the compressed storage, used by find_compressed
+        bool use_cursor = false;
+        mutable std::size_t cursor_major = 0;
+        mutable std::size_t cursor_position = 0;
+
+        // Rows (columns) up to this length are searched linearly, longer ones with a binary search
+        static constexpr std::size_t linear_search_size = 16;
+        static constexpr std::size_t not_found = static_cast<std::size_t>(-1);
+
+        // Compressed (major) and searched (minor) index of element (i, j)
+        static constexpr std::size_t major_index(std::size_t i, std::size_t j)
+        {
+            if constexpr (row_major)
+            {
+                return i;
+            }
+            else
+            {
+                return j;
+            }
+        }
+
+        static constexpr std::size_t minor_index(std::size_t i, std::size_t j)
+        {
+            return major_index(j, i);
+        }
+
+        /*!
+         * Representation of the current state, the caller checks the state
+         */
+        Uncompressed &uncompressed_storage()
+        {
+            return *std::get_if<Uncompressed>(&storage);
+        }
+
+        const Uncompressed &uncompressed_storage() const
+        {
+            return *std::get_if<Uncompressed>(&storage);
+        }
+
+        Compressed &compressed_storage()
+        {
+            return *std::get_if<Compressed>(&storage);
+        }
+
+        const Compressed &compressed_storage() const
+        {
+            return *std::get_if<Compressed>(&storage);
+        }
+
+        /*!
+         * Compressed representation, empty if the matrix is not compressed, for the getters
+         */
+        const Compressed &compressed_or_empty() const
+        {
+            static const Compressed empty;
+            const Compressed *c = std::get_if<Compressed>(&storage);
+            return c ? *c : empty;
+        }
 
     public:
         /*!
@@ -50,12 +178,27 @@ namespace algebra
         void resize(std::size_t nrows, std::size_t ncolumns);
 
         /*!
-         * Method to access element in the matrix
+         * Method to access element in the matrix. On an uncompressed matrix the entries added with add()
+         * are first merged into the map, so concurrent reads are safe only once the coordinate list is empty
+         * (after compress() or a first access)
          * @param i Row index
          * @param j Column index
-         * @return std::out_of_range if indexes are out of range
+         * @return the element, std::out_of_range if indexes are out of range
+         */
+        T operator()(std::size_t i, std::size_t j) const;
+
+        /*!
+         * Enable the cursor on the last accessed element of the compressed matrix: accessing the
+         * elements of a row (column for COLMAJOR) in increasing order costs constant time.
+         * When enabled the const operator() is not safe to call from several threads
+         * @param enable true to enable the cursor
          */
-        const T &operator()(std::size_t i, std::size_t j) const;
+        void set_cursor(bool enable)
+        {
+            use_cursor = enable;
+            cursor_major = 0;
+            cursor_position = 0;
+        }
 
         /*!
          * Method to set/add element in the matrix
@@ -66,23 +209,175 @@ namespace algebra
         T &operator()(std::size_t i, std::size_t j);
 
         /*!
-         * Compress the matrix storage
+         * Method to add a value to an element of the matrix in constant time, repeated entries are summed.
+         * The entries are kept in a coordinate list and sorted only by compress(), or merged
+         * into the uncompressed storage the first time an element is accessed through operator()
+         * @param i Row index
+         * @param j Column index
+         * @param value Value to add
+         * @return std::out_of_range if indexes are out of range
+         */
+        void add(std::size_t i, std::size_t j, const T &value);
+
+        /*!
+         * Set an element of the compressed matrix that belongs to the sparsity pattern, in O(log row length)
+         * (constant time with the cursor for increasing indices within a row)
+         * @param i Row index
+         * @param j Column index
+         * @param value New value of the element
+         * @return std::out_of_range if indexes are out of range, std::runtime_error if the matrix is not compressed
+         *         or the element is not in the pattern
+         */
+        void update(std::size_t i, std::size_t j, const T &value);
+
+        /*!
+         * Add a value to an element of the compressed matrix that belongs to the sparsity pattern, in O(log row length)
+         * @param i Row index
+         * @param j Column index
+         * @param value Value to add
+         * @return std::out_of_range if indexes are out of range, std::runtime_error if the matrix is not compressed
+         *         or the element is not in the pattern
+         */
+        void accumulate(std::size_t i, std::size_t j, const T &value);
+
+        /*!
+         * Add a batch of entries to the compressed matrix, whose pattern must contain all of them.
+         * It may be called concurrently from several threads, e.g. one per group of finite elements: the values
+         * are added atomically and the cursor is not used. The order of the concurrent sums is not deterministic.
+         * If an entry is rejected the ones before it have already been added
+         * @param entries Entries to add
+         * @return std::out_of_range if indexes are out of range, std::runtime_error if the matrix is not compressed
+         *         or an entry is not in the pattern
+         */
+        void assemble(std::span<const Triplet<T>> entries);
+
+        /*!
+         * Add the dense block of a finite element to the compressed matrix, A(rows[a], columns[b]) += block[a * columns.size() + b].
+         * It may be called concurrently from several threads, as assemble() for a batch of entries
+         * @param rows Global row indices of the block
+         * @param columns Global column indices of the block
+         * @param block Row-major values of the block, of size rows.size() * columns.size()
+         * @return std::out_of_range if indexes are out of range, std::runtime_error if the matrix is not compressed,
+         *         the block has the wrong size or an element is not in the pattern
+         */
+        void assemble(std::span<const std::size_t> rows, std::span<const std::size_t> columns, std::span<const T> block);
+
+        /*!
+         * Reserve space for the entries added with add()
+         * @param nnz Expected number of entries
+         */
+        void reserve(std::size_t nnz)
+        {
+            if (Uncompressed *u = std::get_if<Uncompressed>(&storage))
+            {
+                u->triplets.reserve(nnz);
+            }
+        }
+
+        /*!
+         * Compress the matrix storage, the indices within each row (column) are sorted.
+         * The entries are counted per row (column), bucketed and merged by the threads set by set_threads(),
+         * and the compressed arrays are allocated with their exact size
+         * @return std::overflow_error if the dimensions or the number of non-zeros do not fit in Index
          */
         void compress();
 
         /*!
-         * Uncompress the matrix storage
+         * Uncompress the matrix storage. The elements are copied in parallel to the coordinate list,
+         * and merged into the uncompressed storage the first time an element is accessed through operator()
          */
         void uncompress();
 
+        /*!
+         * Get the number of rows
+         */
+        std::size_t get_rows() const
+        {
+            return n_rows;
+        }
+
+        /*!
+         * Get the number of columns
+         */
+        std::size_t get_columns() const
+        {
+            return n_columns;
+        }
+
+        /*!
+         * Get the number of non-zero elements of the compressed matrix
+         */
+        std::size_t get_nnz() const
+        {
+            return compressed_or_empty().values.size();
+        }
+
+        /*!
+         * Get the offsets of the rows (columns for COLMAJOR) of the compressed matrix
+         */
+        const std::vector<Index> &get_offsets() const
+        {
+            return compressed_or_empty().offsets;
+        }
+
+        /*!
+         * Get the column (row for COLMAJOR) indices of the compressed matrix
+         */
+        const std::vector<Index> &get_indices() const
+        {
+            return compressed_or_empty().indices;
+        }
+
+        /*!
+         * Get the values of the compressed matrix
+         */
+        const std::vector<Storage> &get_values() const
+        {
+            return compressed_or_empty().values;
+        }
+
+        /*!
+         * Get the values of the compressed matrix for writing, the sparsity pattern stays the same
+         */
+        std::span<Storage> get_mutable_values()
+        {
+            Compressed *c = std::get_if<Compressed>(&storage);
+            return c ? std::span<Storage>(c->values) : std::span<Storage>();
+        }
+
+        /*!
+         * Replace the matrix with a compressed matrix given by its arrays, which are moved into the matrix
+         * @param nrows Number of rows
+         * @param ncolumns Number of columns
+         * @param offsets Offsets of the rows (columns for COLMAJOR), of size nrows + 1 (ncolumns + 1)
+         * @param indices Column (row for COLMAJOR) indices, sorted within each row (column)
+         * @param values Values of the non-zero elements
+         * @return std::runtime_error if the sizes of the arrays are not consistent
+         */
+        void set_compressed(std::size_t nrows, std::size_t ncolumns, std::vector<Index> offsets, std::vector<Index> indices, std::vector<Storage> values);
+
         /*!
          * Check if the matrix is compressed
          */
-        bool is_compressed()
+        bool is_compressed() const
         {
-            return compressed;
+            return std::holds_alternative<Compressed>(storage);
         }
 
+        /*!
+         * Get the bandwidth of the compressed matrix, the largest |i - j| of its non-zero elements
+         */
+        std::size_t get_bandwidth() const;
+
+        /*!
+         * Renumber rows and columns of a square compressed matrix, B(i, j) = A(permutation[i], permutation[j]),
+         * so that B = P A P^T. The compressed arrays are permuted in parallel and the indices stay sorted.
+         * Use permute_vector() and unpermute_vector() to move the vectors to and from the new numbering
+         * @param permutation new to old numbering, a permutation of 0, ..., n_rows - 1
+         * @return std::runtime_error if the matrix is not compressed and square or permutation is not a permutation of 0, ..., n_rows - 1
+         */
+        void permute(const std::vector<std::size_t> &permutation);
+
         /*!
          * Matrix-vector multiplication operatoration
          * @param v vector to permform the matrix-vector moltiplication
@@ -90,6 +385,72 @@ namespace algebra
          */
         std::vector<T> operator*(const std::vector<T> &v) const;
 
+        /*!
+         * In-place matrix-vector multiplication y = alpha * A * x + beta * y, it does not allocate memory.
+         * If beta is zero y is only written. Raw pointers can be passed as {pointer, size}.
+         * When threaded it uses a workspace of the matrix, so it must not be called concurrently on the same matrix
+         * @param x input vector of size n_columns
+         * @param y output vector of size n_rows
+         * @param alpha scaling of the product
+         * @param beta scaling of y
+         * @return std::runtime_error if the sizes do not match
+         */
+        void multiply(std::span<const T> x, std::span<T> y, T alpha = 1, T beta = 0) const;
+
+        /*!
+         * Fused matrix-vector multiplication and dot product: y = A * x and return w . y, computed while y is written
+         * instead of in a second pass over the vectors (e.g. p . A p in the conjugate gradient).
+         * For a fixed number of threads the result is bitwise reproducible, it does not allocate memory
+         * @param x input vector of size n_columns
+         * @param y output vector of size n_rows
+         * @param w vector of size n_rows, it can be x for square matrices
+         * @return w . (A * x)
+         * @return std::runtime_error if the sizes do not match
+         */
+        T multiply_dot(std::span<const T> x, std::span<T> y, std::span<const T> w) const;
+
+        /*!
+         * In-place transposed matrix-vector multiplication y = alpha * A^T * x + beta * y, using the same compressed
+         * arrays as multiply() without building the transpose
+         * @param x input vector of size n_rows
+         * @param y output vector of size n_columns
+         * @param alpha scaling of the product
+         * @param beta scaling of y
+         * @return std::runtime_error if the sizes do not match
+         */
+        void multiply_transpose(std::span<const T> x, std::span<T> y, T alpha = 1, T beta = 0) const;
+
+        /*!
+         * Matrix-block multiplication, with a dense block of n_vectors vectors.
+         * Each non-zero element is loaded once and multiplied by all the vectors
+         *   @tparam BlockOrder storage order of the dense blocks: ROWMAJOR stores the n_vectors entries
+         *                      of each row contiguously, COLMAJOR stores each vector contiguously
+         * @param X dense block of size n_columns x n_vectors
+         * @param n_vectors number of vectors in the block
+         * @return the dense block of size n_rows x n_vectors containing the result, in BlockOrder
+         */
+        template <StorageOrder BlockOrder>
+        std::vector<T> multiply_block(const std::vector<T> &X, std::size_t n_vectors) const;
+
+        /*!
+         * Set the number of threads used by the compressed matrix-vector multiplication.
+         * For a fixed number of threads the result is bitwise reproducible
+         * @param nthreads Number of threads, 0 selects the hardware concurrency
+         */
+        void set_threads(std::size_t nthreads)
+        {
+            n_threads = nthreads > 0 ? nthreads : std::max(1u, std::thread::hardware_concurrency());
+            setup_threads();
+        }
+
+        /*!
+         * Get the number of threads used by the compressed matrix-vector multiplication
+         */
+        std::size_t get_threads() const
+        {
+            return n_threads;
+        }
+
         /*!
          * Print the matrix
          */
@@ -107,9 +468,86 @@ namespace algebra
         }
 
         /*!
-         * Read matrix a file formatted in matrix market format
+         * Read matrix a file formatted in matrix market format. The file is memory mapped and parsed with the
+         * threads set by set_threads(), symmetric and skew-symmetric matrices are expanded to general ones.
+         * The entries are stored in the coordinate list, so that compress() builds the compressed storage directly
+         * @param file_path Path of the file
+         * @return std::runtime_error if the file cannot be read or its format is not supported
+         */
+        void read_from_file(const std::string &file_path);
+
+        /*!
+         * Write the compressed matrix in binary format: a header followed by the offsets, indices and values arrays
+         * @param file_path Path of the file
+         * @return std::runtime_error if the matrix is not compressed or the file cannot be written
+         */
+        void save_binary(const std::string &file_path) const;
+
+        /*!
+         * Read a compressed matrix written by save_binary(), the file is memory mapped
+         * @param file_path Path of the file
+         * @return std::runtime_error if the file cannot be read or was written by a different Matrix type
+         */
+        void read_binary(const std::string &file_path);
+
+    private:
+        /*!
+         * Merge the entries appended by add() into the map of the uncompressed storage
+         */
+        static void flush_triplets(const Uncompressed &u);
+
+        /*!
+         * Search an element in the compressed storage
+         * @param c Compressed storage of the matrix
+         * @param major Row index for ROWMAJOR, column index for COLMAJOR
+         * @param minor Column index for ROWMAJOR, row index for COLMAJOR
+         * @return the position of the element in the values, not_found if it is zero
+         */
+        std::size_t find_compressed(const Compressed &c, std::size_t major, std::size_t minor) const;
+
+        /*!
+         * Position of the first index not smaller than minor in the compressed row (column) major,
+         * it does not use the cursor so it is safe to call concurrently
+         */
+        static std::size_t lower_position(const Compressed &c, std::size_t major, std::size_t minor);
+
+        /*!
+         * Position of an element of the pattern of the compressed matrix, for update(), accumulate() and assemble()
+         * @return std::out_of_range if indexes are out of range, std::runtime_error if the element is not in the pattern
+         */
+        std::size_t pattern_position(std::size_t i, std::size_t j, bool concurrent) const;
+
+        /*!
+         * Multiply row i of the compressed row-major matrix by the Width vectors of the block starting from vector first
+         */
+        template <StorageOrder BlockOrder, std::size_t Width>
+        void multiply_row_block(const Compressed &c, const T *X, T *Y, std::size_t n_vectors, std::size_t i, std::size_t first) const;
+
+        /*!
+         * Compute the thread bounds and size the workspace of the compressed matrix for the current number of threads
+         */
+        void setup_threads();
+
+        /*!
+         * Products with the uncompressed storage, y = alpha * A * x + beta * y or, with Transpose, y = alpha * A^T * x + beta * y
          */
-        void read_from_file(std::string &file_path);
+        template <bool Transpose>
+        static void uncompressed_product(const Uncompressed &u, std::span<const T> x, std::span<T> y, T alpha, T beta);
+
+        /*!
+         * y = alpha * B * x + beta * y where B is the matrix whose rows are the compressed rows (columns for COLMAJOR),
+         * each thread computes whole entries of y. With Dot it also returns w . y, summed in thread order
+         */
+        template <bool Dot>
+        T gather_product(const Compressed &c, const T *x, T *y, T alpha, T beta, const T *w = nullptr) const;
+
+        /*!
+         * y = alpha * B^T * x + beta * y where B is the matrix whose rows are the compressed rows (columns for COLMAJOR),
+         * each thread scatters in its own part of the workspace, then the parts are summed in thread order.
+         * With Dot it also returns w . y
+         */
+        template <bool Dot>
+        T scatter_product(const Compressed &c, const T *x, T *y, std::size_t y_size, T alpha, T beta, const T *w = nullptr) const;
     };
 
     /*
@@ -117,254 +555,967 @@ namespace algebra
      * Definitions
      * ***************************************************************************
      */
-    template <typename T, StorageOrder Order>
-    void Matrix<T, Order>::resize(std::size_t nrows, std::size_t ncolumns)
+    template <typename T, StorageOrder Order, typename Index, typename Storage>
+    void Matrix<T, Order, Index, Storage>::resize(std::size_t nrows, std::size_t ncolumns)
     {
         n_rows = nrows;
         n_columns = ncolumns;
     };
 
-    template <typename T, StorageOrder Order>
-    const T &Matrix<T, Order>::operator()(std::size_t i, std::size_t j) const
+    template <typename T, StorageOrder Order, typename Index, typename Storage>
+    T Matrix<T, Order, Index, Storage>::operator()(std::size_t i, std::size_t j) const
     {
         if (i >= n_rows || j >= n_columns)
         {
             throw std::out_of_range("Index out of range");
         }
-        if (!compressed)
+        if (const Compressed *c = std::get_if<Compressed>(&storage))
         {
-            auto it = uncompressed_data.find({i, j});
-            return (it != uncompressed_data.end()) ? it->second : sparse_element;
+            // Localizing the row (column) and searching the column (row) index
+            std::size_t k = find_compressed(*c, major_index(i, j), minor_index(i, j));
+
+            // return 0 if the element is not found
+            return (k != not_found) ? static_cast<T>(c->values[k]) : T(0);
         }
-        else
+
+        const Uncompressed &u = uncompressed_storage();
+        flush_triplets(u);
+        auto it = u.data.find({i, j});
+        return (it != u.data.end()) ? it->second : T(0);
+    };
+
+    template <typename T, StorageOrder Order, typename Index, typename Storage>
+    std::size_t Matrix<T, Order, Index, Storage>::find_compressed(const Compressed &c, std::size_t major, std::size_t minor) const
+    {
+        std::size_t start = c.offsets[major];
+        std::size_t end = c.offsets[major + 1];
+        std::size_t k;
+
+        if (use_cursor && cursor_major == major && cursor_position >= start && cursor_position < end && c.indices[cursor_position] <= minor)
         {
-            if (Order == StorageOrder::ROWMAJOR)
+            // Exponential search forward from the last position, constant time for sequential accesses
+            std::size_t step = 1;
+            while (cursor_position + step < end && c.indices[cursor_position + step] < minor)
             {
-                // Localizing the row
-                std::size_t row_start = offsets_vector[i];
-                std::size_t row_end = offsets_vector[i + 1];
+                step *= 2;
+            }
+            auto first = c.indices.begin() + cursor_position + step / 2;
+            auto last = c.indices.begin() + std::min(cursor_position + step, end);
+            k = std::lower_bound(first, last, minor) - c.indices.begin();
+        }
+        else
+        {
+            k = lower_position(c, major, minor);
+        }
 
-                // Scan the row's columns 
-                for (std::size_t k = row_start; k < row_end; ++k)
-                {   
-                    // Return the element if the right index is found     
-                    if (indices_vector[k] == j)
-                    {
-                        return compressed_data[k];
-                    }
-                }
+        bool found = (k < end && c.indices[k] == minor);
 
-                // return 0 if the element is not found
-                return sparse_element;
-            }
-            else
-            {
-                // Localizing the column 
-                std::size_t col_start = offsets_vector[j];
-                std::size_t col_end = offsets_vector[j + 1];
+        if (use_cursor)
+        {
+            cursor_major = major;
+            cursor_position = (found || k == start) ? k : k - 1;
+        }
 
-                // Scan the column's rows 
-                for (std::size_t k = col_start; k < col_end; ++k)
-                {
-                    // Return the element if the right index is found 
-                    if (indices_vector[k] == i)
-                    {
-                        return compressed_data[k];
-                    }
-                }
+        return found ? k : not_found;
+    }
+
+    template <typename T, StorageOrder Order, typename Index, typename Storage>
+    std::size_t Matrix<T, Order, Index, Storage>::lower_position(const Compressed &c, std::size_t major, std::size_t minor)
+    {
+        std::size_t start = c.offsets[major];
+        std::size_t end = c.offsets[major + 1];
 
-                // return 0 if the element is not found
-                return sparse_element;
+        if (end - start <= linear_search_size)
+        {
+            // Branchless count of the smaller indices, it is the position of the index since the indices are sorted
+            std::size_t k = start;
+            for (std::size_t p = start; p < end; ++p)
+            {
+                k += (c.indices[p] < minor);
             }
+            return k;
         }
-    };
+        return std::lower_bound(c.indices.begin() + start, c.indices.begin() + end, minor) - c.indices.begin();
+    }
 
-    template <typename T, StorageOrder Order>
-    T &Matrix<T, Order>::operator()(std::size_t i, std::size_t j)
+    template <typename T, StorageOrder Order, typename Index, typename Storage>
+    std::size_t Matrix<T, Order, Index, Storage>::pattern_position(std::size_t i, std::size_t j, bool concurrent) const
     {
         if (i >= n_rows || j >= n_columns)
         {
             throw std::out_of_range("Index out of range");
         }
-        if (compressed)
+        const Compressed *c = std::get_if<Compressed>(&storage);
+        if (!c)
         {
-            throw std::runtime_error("Cannot insert elements in compressed state");
+            throw std::runtime_error("The matrix must be compressed to update its values");
         }
-        else
+
+        const std::size_t major = major_index(i, j);
+        const std::size_t minor = minor_index(i, j);
+        std::size_t k = concurrent ? lower_position(*c, major, minor) : find_compressed(*c, major, minor);
+        if (k == not_found || k == c->offsets[major + 1] || c->indices[k] != minor)
         {
-            return uncompressed_data[{i, j}];
+            throw std::runtime_error("Element (" + std::to_string(i) + ", " + std::to_string(j) + ") is not in the sparsity pattern");
         }
+        return k;
+    }
+
+    template <typename T, StorageOrder Order, typename Index, typename Storage>
+    T &Matrix<T, Order, Index, Storage>::operator()(std::size_t i, std::size_t j)
+    {
+        if (i >= n_rows || j >= n_columns)
+        {
+            throw std::out_of_range("Index out of range");
+        }
+        Uncompressed *u = std::get_if<Uncompressed>(&storage);
+        if (!u)
+        {
+            throw std::runtime_error("Cannot insert elements in compressed state");
+        }
+
+        flush_triplets(*u);
+        return u->data[{i, j}];
     };
 
-    template <typename T, StorageOrder Order>
-    void Matrix<T, Order>::compress()
+    template <typename T, StorageOrder Order, typename Index, typename Storage>
+    void Matrix<T, Order, Index, Storage>::add(std::size_t i, std::size_t j, const T &value)
     {
-        if (!compressed)
+        if (i >= n_rows || j >= n_columns)
         {
-            offsets_vector.resize(n_rows + 1);
+            throw std::out_of_range("Index out of range");
+        }
+        Uncompressed *u = std::get_if<Uncompressed>(&storage);
+        if (!u)
+        {
+            throw std::runtime_error("Cannot insert elements in compressed state");
+        }
 
-            if (Order == StorageOrder::ROWMAJOR)
-            {
-                // Compressed Sparse Row
-                for (const auto &elem : uncompressed_data)
-                {
-                    std::size_t i = elem.first[0];
-                    std::size_t j = elem.first[1];
+        u->triplets.push_back({i, j, value});
+    }
 
-                    // Populate data vector
-                    compressed_data.push_back(elem.second);
+    template <typename T, StorageOrder Order, typename Index, typename Storage>
+    void Matrix<T, Order, Index, Storage>::update(std::size_t i, std::size_t j, const T &value)
+    {
+        const std::size_t k = pattern_position(i, j, false);
+        compressed_storage().values[k] = static_cast<Storage>(value);
+    }
 
-                    // Populate column indices vector
-                    indices_vector.push_back(j);
+    template <typename T, StorageOrder Order, typename Index, typename Storage>
+    void Matrix<T, Order, Index, Storage>::accumulate(std::size_t i, std::size_t j, const T &value)
+    {
+        const std::size_t k = pattern_position(i, j, false);
+        Storage &element = compressed_storage().values[k];
+        element = static_cast<Storage>(static_cast<T>(element) + value);
+    }
 
-                    // Counting the number of non-zero elements encountered in each row of the matrix
-                    offsets_vector[i + 1]++;
-                }
+    template <typename T, StorageOrder Order, typename Index, typename Storage>
+    void Matrix<T, Order, Index, Storage>::assemble(std::span<const Triplet<T>> entries)
+    {
+        for (const auto &t : entries)
+        {
+            const std::size_t k = pattern_position(t.row, t.column, true);
+            std::atomic_ref<Storage>(compressed_storage().values[k]).fetch_add(static_cast<Storage>(t.value), std::memory_order_relaxed);
+        }
+    }
 
-                // Accumulates the counts from the previous rows, effectively transforming the counts into the starting indexes for each row in the compressed format
-                for (std::size_t i = 1; i <= n_rows; ++i)
-                {
-                    // Populating starting row offset vector
-                    offsets_vector[i] += offsets_vector[i - 1];
-                }
+    template <typename T, StorageOrder Order, typename Index, typename Storage>
+    void Matrix<T, Order, Index, Storage>::assemble(std::span<const std::size_t> rows, std::span<const std::size_t> columns, std::span<const T> block)
+    {
+        if (block.size() != rows.size() * columns.size())
+        {
+            throw std::runtime_error("Non conforming size of the element block");
+        }
+
+        for (std::size_t a = 0; a < rows.size(); ++a)
+        {
+            for (std::size_t b = 0; b < columns.size(); ++b)
+            {
+                const std::size_t k = pattern_position(rows[a], columns[b], true);
+                std::atomic_ref<Storage>(compressed_storage().values[k]).fetch_add(static_cast<Storage>(block[a * columns.size() + b]), std::memory_order_relaxed);
             }
-            else
+        }
+    }
+
+    template <typename T, StorageOrder Order, typename Index, typename Storage>
+    void Matrix<T, Order, Index, Storage>::flush_triplets(const Uncompressed &u)
+    {
+        if (u.triplets.empty())
+        {
+            return;
+        }
+
+        std::stable_sort(u.triplets.begin(), u.triplets.end(), [](const Triplet<T> &a, const Triplet<T> &b)
+                         { return a.row < b.row || (a.row == b.row && a.column < b.column); });
+
+        // Sorted keys are inserted right before the hint in constant time
+        auto hint = u.data.begin();
+        for (const auto &t : u.triplets)
+        {
+            hint = u.data.try_emplace(hint, std::array<std::size_t, 2>{t.row, t.column}, 0);
+            hint->second += t.value;
+            ++hint;
+        }
+
+        std::vector<Triplet<T>>().swap(u.triplets);
+    }
+
+    template <typename T, StorageOrder Order, typename Index, typename Storage>
+    void Matrix<T, Order, Index, Storage>::compress()
+    {
+        Uncompressed *u = std::get_if<Uncompressed>(&storage);
+        if (!u)
+        {
+            std::cout << "Matrix already compressed" << std::endl;
+            return;
+        }
+
+        // Rows are the major index for Compressed Sparse Row, columns for Compressed Sparse Column
+        const std::size_t n_major = major_index(n_rows, n_columns);
+        const auto &triplets = u->triplets;
+        const auto &uncompressed_data = u->data;
+
+        // Thread t buckets the t-th part of the coordinate list, thread 0 also the map entries that come first,
+        // so that the entries of each row/column keep their insertion order whatever the number of threads
+        const std::size_t n_parts = std::max<std::size_t>(1, std::min(n_threads, triplets.size() / 4096 + 1));
+        auto part_begin = [&](std::size_t t)
+        { return triplets.size() * t / n_parts; };
+
+        // First pass: counting the entries (repeated ones included) of each row/column in each part
+        std::vector<std::vector<std::size_t>> counts(n_parts, std::vector<std::size_t>(n_major, 0));
+        parallel_for(n_parts, [&](std::size_t t)
+                     {
+            auto &count = counts[t];
+            if (t == 0)
             {
-                // Compressed Sparse Column
                 for (const auto &elem : uncompressed_data)
                 {
-                    std::size_t i = elem.first[0];
-                    std::size_t j = elem.first[1];
+                    count[major_index(elem.first[0], elem.first[1])]++;
+                }
+            }
+            for (std::size_t e = part_begin(t); e < part_begin(t + 1); ++e)
+            {
+                count[major_index(triplets[e].row, triplets[e].column)]++;
+            } });
+
+        // Prefix sum: starts of the rows/columns, and the counts become the first position of each part in them
+        std::vector<std::size_t> starts(n_major + 1, 0);
+        for (std::size_t m = 0; m < n_major; ++m)
+        {
+            std::size_t position = starts[m];
+            for (auto &count : counts)
+            {
+                std::size_t c = count[m];
+                count[m] = position;
+                position += c;
+            }
+            starts[m + 1] = position;
+        }
+
+        if (std::max(n_rows, n_columns) > std::numeric_limits<Index>::max() || starts[n_major] > std::numeric_limits<Index>::max())
+        {
+            throw std::overflow_error("Matrix too large for its index type, use a wider Index");
+        }
 
-                    // Populate data vector
-                    compressed_data.push_back(elem.second);
+        // Second pass: scattering the entries in their row/column (counting sort)
+        std::vector<std::pair<Index, T>> entries(starts[n_major]);
+        parallel_for(n_parts, [&](std::size_t t)
+                     {
+            auto &next = counts[t];
+            if (t == 0)
+            {
+                for (const auto &elem : uncompressed_data)
+                {
+                    entries[next[major_index(elem.first[0], elem.first[1])]++] = {static_cast<Index>(minor_index(elem.first[0], elem.first[1])), elem.second};
+                }
+            }
+            for (std::size_t e = part_begin(t); e < part_begin(t + 1); ++e)
+            {
+                const auto &entry = triplets[e];
+                entries[next[major_index(entry.row, entry.column)]++] = {static_cast<Index>(minor_index(entry.row, entry.column)), entry.value};
+            } });
+        std::vector<std::vector<std::size_t>>().swap(counts);
 
-                    // Populate row indices vector
-                    indices_vector.push_back(i);
+        // The uncompressed representation is destroyed before the compressed arrays are allocated
+        storage.template emplace<Compressed>();
+        Compressed &c = compressed_storage();
 
-                    // Counting the number of non-zero elements encountered in each column of the matrix
-                    offsets_vector[j + 1]++;
+        // Sort each row/column by its minor index and sum the repeated entries in place,
+        // the threads take rows/columns holding about the same number of entries. The number of threads
+        // depends on all the entries, map included, since a matrix filled through operator() has no triplets
+        const std::size_t n_merge = std::max<std::size_t>(1, std::min(n_threads, starts[n_major] / 4096 + 1));
+        const std::vector<std::size_t> bounds = balanced_partition(starts, n_merge);
+        std::vector<std::size_t> lengths(n_major + 1, 0);
+        parallel_for(n_merge, [&](std::size_t t)
+                     {
+            for (std::size_t m = bounds[t]; m < bounds[t + 1]; ++m)
+            {
+                auto first = entries.begin() + starts[m];
+                auto last = entries.begin() + starts[m + 1];
+                if (last - first <= 32)
+                {
+                    // Insertion sort, stable and without allocations for the short rows/columns
+                    for (auto it = first + std::min<std::ptrdiff_t>(1, last - first); it < last; ++it)
+                    {
+                        auto entry = *it;
+                        auto hole = it;
+                        for (; hole != first && (hole - 1)->first > entry.first; --hole)
+                        {
+                            *hole = *(hole - 1);
+                        }
+                        *hole = entry;
+                    }
+                }
+                else
+                {
+                    std::stable_sort(first, last, [](const auto &a, const auto &b)
+                                     { return a.first < b.first; });
                 }
 
-                // Accumulates the counts from the previous columns, effectively transforming the counts into the starting indexes for each column in the compressed format
-                for (std::size_t j = 1; j <= n_columns; ++j)
+                // Repeated entries are summed in T, in insertion order
+                auto merged = first;
+                for (auto it = first; it != last; ++merged)
                 {
-                    // Populating starting column offset vector
-                    offsets_vector[j] += offsets_vector[j - 1];
+                    *merged = *it;
+                    for (++it; it != last && it->first == merged->first; ++it)
+                    {
+                        merged->second += it->second;
+                    }
                 }
-            }
-            compressed = true;
-            uncompressed_data.clear();
-        }
-        else
+                lengths[m + 1] = merged - first;
+            } });
+
+        c.offsets.resize(n_major + 1);
+        c.offsets[0] = 0;
+        for (std::size_t m = 0; m < n_major; ++m)
         {
-            std::cout << "Matrix already compressed" << std::endl;
+            lengths[m + 1] += lengths[m];
+            c.offsets[m + 1] = static_cast<Index>(lengths[m + 1]);
         }
+
+        // The compressed arrays get their exact size, each thread copies its rows/columns
+        c.indices.resize(lengths[n_major]);
+        c.values.resize(lengths[n_major]);
+        parallel_for(n_merge, [&](std::size_t t)
+                     {
+            for (std::size_t m = bounds[t]; m < bounds[t + 1]; ++m)
+            {
+                for (std::size_t k = lengths[m], e = starts[m]; k < lengths[m + 1]; ++k, ++e)
+                {
+                    c.indices[k] = entries[e].first;
+                    c.values[k] = static_cast<Storage>(entries[e].second);
+                }
+            } });
+
+        setup_threads();
     }
 
-    template <typename T, StorageOrder Order>
-    void Matrix<T, Order>::uncompress()
+    template <typename T, StorageOrder Order, typename Index, typename Storage>
+    void Matrix<T, Order, Index, Storage>::uncompress()
     {
-
-        if (Order == StorageOrder::ROWMAJOR)
+        const Compressed *c = std::get_if<Compressed>(&storage);
+        if (!c)
         {
-            for (std::size_t i = 0; i < n_rows; ++i)
+            std::cout << "Matrix is not compressed" << std::endl;
+            return;
+        }
+
+        // Each thread copies its rows/columns to the coordinate list, which is ordered like the compressed storage
+        std::vector<Triplet<T>> triplets(c->values.size());
+        parallel_for(n_threads, [&](std::size_t t)
+                     {
+            for (std::size_t m = c->thread_bounds[t]; m < c->thread_bounds[t + 1]; ++m)
             {
-                for (std::size_t k = offsets_vector[i]; k < offsets_vector[i + 1]; ++k)
+                for (std::size_t k = c->offsets[m]; k < c->offsets[m + 1]; ++k)
                 {
-                    uncompressed_data[{i, indices_vector[k]}] = compressed_data[k];
+                    if constexpr (row_major)
+                    {
+                        triplets[k] = {m, c->indices[k], static_cast<T>(c->values[k])};
+                    }
+                    else
+                    {
+                        triplets[k] = {c->indices[k], m, static_cast<T>(c->values[k])};
+                    }
                 }
+            } });
+
+        // Replacing the representation releases the compressed arrays and the workspace
+        storage.template emplace<Uncompressed>().triplets = std::move(triplets);
+    }
+
+    template <typename T, StorageOrder Order, typename Index, typename Storage>
+    std::size_t Matrix<T, Order, Index, Storage>::get_bandwidth() const
+    {
+        const auto &offsets = get_offsets();
+        const auto &indices = get_indices();
+        std::size_t bandwidth = 0;
+        for (std::size_t m = 0; m + 1 < offsets.size(); ++m)
+        {
+            if (offsets[m] == offsets[m + 1])
+            {
+                continue;
             }
+            // Indices are sorted, the farthest ones from the diagonal are the first and the last of each row/column
+            std::size_t first = indices[offsets[m]];
+            std::size_t last = indices[offsets[m + 1] - 1];
+            bandwidth = std::max({bandwidth, m > first ? m - first : first - m, m > last ? m - last : last - m});
+        }
+        return bandwidth;
+    }
 
-            compressed = false;
-            compressed_data.clear();
-            offsets_vector.clear();
-            indices_vector.clear();
+    template <typename T, StorageOrder Order, typename Index, typename Storage>
+    void Matrix<T, Order, Index, Storage>::permute(const std::vector<std::size_t> &permutation)
+    {
+        Compressed *c = std::get_if<Compressed>(&storage);
+        if (!c || n_rows != n_columns)
+        {
+            throw std::runtime_error("Only square compressed matrices can be permuted");
         }
-        else
+        check_permutation(permutation, n_rows);
+
+        const std::size_t n = n_rows;
+        std::vector<Index> inverse(n, 0);
+        for (std::size_t i = 0; i < n; ++i)
         {
-            std::cout << "Matrix is not compressed" << std::endl;
+            inverse[permutation[i]] = static_cast<Index>(i);
         }
+
+        // Row/column i of the result is the row/column permutation[i] of the matrix, with renumbered indices
+        std::vector<Index> offsets(n + 1, 0);
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            offsets[i + 1] = offsets[i] + (c->offsets[permutation[i] + 1] - c->offsets[permutation[i]]);
+        }
+        std::vector<Index> indices(c->indices.size());
+        std::vector<Storage> values(c->values.size());
+
+        const std::vector<std::size_t> bounds = balanced_partition(offsets, n_threads);
+        parallel_for(n_threads, [&](std::size_t t)
+                     {
+            std::vector<std::pair<Index, Storage>> row;
+            for (std::size_t i = bounds[t]; i < bounds[t + 1]; ++i)
+            {
+                row.clear();
+                for (std::size_t k = c->offsets[permutation[i]]; k < c->offsets[permutation[i] + 1]; ++k)
+                {
+                    row.emplace_back(inverse[c->indices[k]], c->values[k]);
+                }
+                std::sort(row.begin(), row.end(), [](const auto &a, const auto &b)
+                          { return a.first < b.first; });
+                for (std::size_t k = offsets[i], r = 0; r < row.size(); ++k, ++r)
+                {
+                    indices[k] = row[r].first;
+                    values[k] = row[r].second;
+                }
+            } });
+
+        c->offsets = std::move(offsets);
+        c->indices = std::move(indices);
+        c->values = std::move(values);
+        setup_threads();
     }
 
-    template <typename T, StorageOrder Order>
-    std::vector<T> Matrix<T, Order>::operator*(const std::vector<T> &v) const
+    template <typename T, StorageOrder Order, typename Index, typename Storage>
+    std::vector<T> Matrix<T, Order, Index, Storage>::operator*(const std::vector<T> &v) const
     {
         if (v.size() != n_columns)
         {
             throw std::runtime_error("Non comforming size for the input vector");
         }
 
-        std::vector<T> result(n_rows, 0); // Initialize result vector
+        std::vector<T> result(n_rows);
+        multiply(v, result);
+
+        return result;
+    };
+
+    template <typename T, StorageOrder Order, typename Index, typename Storage>
+    void Matrix<T, Order, Index, Storage>::multiply(std::span<const T> x, std::span<T> y, T alpha, T beta) const
+    {
+        if (x.size() != n_columns || y.size() != n_rows)
+        {
+            throw std::runtime_error("Non comforming size for the input vector");
+        }
 
-        if (compressed)
+        if (const Compressed *c = std::get_if<Compressed>(&storage))
         {
-            // Compressed state
-            if (Order == StorageOrder::ROWMAJOR)
+            if constexpr (row_major)
             {
                 // Row-wise multiplication (CSR format)
-                for (std::size_t i = 0; i < n_rows; ++i)
-                {
-                    for (std::size_t k = offsets_vector[i]; k < offsets_vector[i + 1]; ++k)
-                    {
-                        result[i] += compressed_data[k] * v[indices_vector[k]];
-                    }
-                }
+                gather_product<false>(*c, x.data(), y.data(), alpha, beta);
             }
             else
             {
                 // Column-wise multiplication (CSC format)
-                for (std::size_t j = 0; j < n_columns; ++j)
+                scatter_product<false>(*c, x.data(), y.data(), n_rows, alpha, beta);
+            }
+        }
+        else
+        {
+            uncompressed_product<false>(uncompressed_storage(), x, y, alpha, beta);
+        }
+    }
+
+    template <typename T, StorageOrder Order, typename Index, typename Storage>
+    T Matrix<T, Order, Index, Storage>::multiply_dot(std::span<const T> x, std::span<T> y, std::span<const T> w) const
+    {
+        if (x.size() != n_columns || y.size() != n_rows || w.size() != n_rows)
+        {
+            throw std::runtime_error("Non comforming size for the input vector");
+        }
+
+        if (const Compressed *c = std::get_if<Compressed>(&storage))
+        {
+            if constexpr (row_major)
+            {
+                return gather_product<true>(*c, x.data(), y.data(), T(1), T(0), w.data());
+            }
+            else
+            {
+                return scatter_product<true>(*c, x.data(), y.data(), n_rows, T(1), T(0), w.data());
+            }
+        }
+
+        multiply(x, y);
+        T dot = 0;
+        for (std::size_t i = 0; i < n_rows; ++i)
+        {
+            dot += w[i] * y[i];
+        }
+        return dot;
+    }
+
+    template <typename T, StorageOrder Order, typename Index, typename Storage>
+    void Matrix<T, Order, Index, Storage>::multiply_transpose(std::span<const T> x, std::span<T> y, T alpha, T beta) const
+    {
+        if (x.size() != n_rows || y.size() != n_columns)
+        {
+            throw std::runtime_error("Non comforming size for the input vector");
+        }
+
+        if (const Compressed *c = std::get_if<Compressed>(&storage))
+        {
+            if constexpr (row_major)
+            {
+                // The rows of A are the columns of A^T
+                scatter_product<false>(*c, x.data(), y.data(), n_columns, alpha, beta);
+            }
+            else
+            {
+                // The columns of A are the rows of A^T
+                gather_product<false>(*c, x.data(), y.data(), alpha, beta);
+            }
+        }
+        else
+        {
+            uncompressed_product<true>(uncompressed_storage(), x, y, alpha, beta);
+        }
+    }
+
+    template <typename T, StorageOrder Order, typename Index, typename Storage>
+    template <bool Transpose>
+    void Matrix<T, Order, Index, Storage>::uncompressed_product(const Uncompressed &u, std::span<const T> x, std::span<T> y, T alpha, T beta)
+    {
+        for (auto &element : y)
+        {
+            element = (beta == T(0)) ? T(0) : beta * element;
+        }
+        auto multiply_entry = [&](std::size_t i, std::size_t j, const T &value)
+        {
+            if constexpr (Transpose)
+            {
+                y[j] += value * (alpha * x[i]);
+            }
+            else
+            {
+                y[i] += value * (alpha * x[j]);
+            }
+        };
+        for (const auto &elem : u.data)
+        {
+            multiply_entry(elem.first[0], elem.first[1], elem.second);
+        }
+        for (const auto &t : u.triplets)
+        {
+            multiply_entry(t.row, t.column, t.value);
+        }
+    }
+
+    template <typename T, StorageOrder Order, typename Index, typename Storage>
+    void Matrix<T, Order, Index, Storage>::setup_threads()
+    {
+        Compressed *c = std::get_if<Compressed>(&storage);
+        if (!c)
+        {
+            return;
+        }
+
+        c->thread_bounds = balanced_partition(c->offsets, n_threads);
+
+        // Scattering products write at most max(n_rows, n_columns) entries per thread
+        c->workspace.assign(n_threads > 1 ? n_threads * std::max(n_rows, n_columns) : 0, T(0));
+        c->partial_dots.assign(n_threads, T(0));
+    }
+
+    template <typename T, StorageOrder Order, typename Index, typename Storage>
+    template <bool Dot>
+    T Matrix<T, Order, Index, Storage>::gather_product(const Compressed &c, const T *x, T *y, T alpha, T beta, const T *w) const
+    {
+        // Each thread owns a block of rows with about the same number of non-zeros,
+        // so every entry of the result is summed in the same order as in the serial loop
+        parallel_for(n_threads, [&](std::size_t t)
+                     {
+            T dot = 0;
+            for (std::size_t i = c.thread_bounds[t]; i < c.thread_bounds[t + 1]; ++i)
+            {
+                T sum = 0;
+                for (std::size_t k = c.offsets[i]; k < c.offsets[i + 1]; ++k)
                 {
-                    for (std::size_t k = offsets_vector[j]; k < offsets_vector[j + 1]; ++k)
-                    {
-                        result[indices_vector[k]] += compressed_data[k] * v[j];
-                    }
+                    sum += static_cast<T>(c.values[k]) * x[c.indices[k]];
+                }
+                y[i] = (beta == T(0)) ? alpha * sum : alpha * sum + beta * y[i];
+                if constexpr (Dot)
+                {
+                    dot += w[i] * y[i];
                 }
             }
+            c.partial_dots[t] = dot; });
+
+        T dot = 0;
+        for (std::size_t t = 0; t < n_threads; ++t)
+        {
+            dot += c.partial_dots[t];
         }
-        else
+        return dot;
+    }
+
+    template <typename T, StorageOrder Order, typename Index, typename Storage>
+    template <bool Dot>
+    T Matrix<T, Order, Index, Storage>::scatter_product(const Compressed &c, const T *x, T *y, std::size_t y_size, T alpha, T beta, const T *w) const
+    {
+        const std::size_t n_major = c.offsets.size() - 1;
+
+        if (n_threads == 1)
         {
-            // Uncompressed state
-            for (const auto &elem : uncompressed_data)
+            for (std::size_t i = 0; i < y_size; ++i)
+            {
+                y[i] = (beta == T(0)) ? T(0) : beta * y[i];
+            }
+            for (std::size_t j = 0; j < n_major; ++j)
             {
-                std::size_t i = elem.first[0];
-                std::size_t j = elem.first[1];
+                const T scaled = alpha * x[j];
+                for (std::size_t k = c.offsets[j]; k < c.offsets[j + 1]; ++k)
+                {
+                    y[c.indices[k]] += static_cast<T>(c.values[k]) * scaled;
+                }
+            }
 
-                result[i] += elem.second * v[j];
+            // Entries of y are final only at the end of the scattering
+            T dot = 0;
+            if constexpr (Dot)
+            {
+                for (std::size_t i = 0; i < y_size; ++i)
+                {
+                    dot += w[i] * y[i];
+                }
             }
+            return dot;
         }
 
-        return result;
-    };
+        // Each thread scatters a block of columns in its own partial result
+        parallel_for(n_threads, [&](std::size_t t)
+                     {
+            T *local = c.workspace.data() + t * y_size;
+            std::fill(local, local + y_size, T(0));
+            for (std::size_t j = c.thread_bounds[t]; j < c.thread_bounds[t + 1]; ++j)
+            {
+                const T scaled = alpha * x[j];
+                for (std::size_t k = c.offsets[j]; k < c.offsets[j + 1]; ++k)
+                {
+                    local[c.indices[k]] += static_cast<T>(c.values[k]) * scaled;
+                }
+            } });
+
+        // The partial results are reduced in thread order, the dot product is computed during the reduction
+        parallel_for(n_threads, [&](std::size_t t)
+                     {
+            T dot = 0;
+            for (std::size_t i = y_size * t / n_threads; i < y_size * (t + 1) / n_threads; ++i)
+            {
+                T sum = (beta == T(0)) ? T(0) : beta * y[i];
+                for (std::size_t p = 0; p < n_threads; ++p)
+                {
+                    sum += c.workspace[p * y_size + i];
+                }
+                y[i] = sum;
+                if constexpr (Dot)
+                {
+                    dot += w[i] * sum;
+                }
+            }
+            c.partial_dots[t] = dot; });
 
-    template <typename T, StorageOrder Order>
-    void Matrix<T, Order>::read_from_file(std::string &file_path)
+        T dot = 0;
+        for (std::size_t t = 0; t < n_threads; ++t)
+        {
+            dot += c.partial_dots[t];
+        }
+        return dot;
+    }
+
+    template <typename T, StorageOrder Order, typename Index, typename Storage>
+    template <StorageOrder BlockOrder>
+    std::vector<T> Matrix<T, Order, Index, Storage>::multiply_block(const std::vector<T> &X, std::size_t n_vectors) const
     {
-        std::fstream myfile(file_path);
-        std::size_t i, j, n_lines;
-        double value;
+        if (X.size() != n_columns * n_vectors)
+        {
+            throw std::runtime_error("Non comforming size for the input block");
+        }
+
+        std::vector<T> Y(n_rows * n_vectors, 0); // Initialize result block
+
+        // Position of the entry (row, vector) of a dense block with n rows
+        auto position = [n_vectors](std::size_t n, std::size_t row, std::size_t vector)
+        {
+            if constexpr (BlockOrder == StorageOrder::ROWMAJOR)
+            {
+                return row * n_vectors + vector;
+            }
+            else
+            {
+                return vector * n + row;
+            }
+        };
+
+        const Compressed *c = std::get_if<Compressed>(&storage);
+        if (!c)
+        {
+            // Uncompressed state
+            auto multiply_entry = [&](std::size_t i, std::size_t j, const T &value)
+            {
+                for (std::size_t w = 0; w < n_vectors; ++w)
+                {
+                    Y[position(n_rows, i, w)] += value * X[position(n_columns, j, w)];
+                }
+            };
+            const Uncompressed &u = uncompressed_storage();
+            for (const auto &elem : u.data)
+            {
+                multiply_entry(elem.first[0], elem.first[1], elem.second);
+            }
+            for (const auto &t : u.triplets)
+            {
+                multiply_entry(t.row, t.column, t.value);
+            }
+            return Y;
+        }
 
-        if (myfile.is_open())
+        if constexpr (row_major)
         {
-            // Ignore comments headers
-            while (myfile.peek() == '%')
+            // Each row is multiplied by groups of 16, 8, 4, 2 or 1 vectors, accumulated in registers
+            parallel_for(n_threads, [&](std::size_t t)
+                         {
+                for (std::size_t i = c->thread_bounds[t]; i < c->thread_bounds[t + 1]; ++i)
+                {
+                    std::size_t first = 0;
+                    for (; first + 16 <= n_vectors; first += 16)
+                    {
+                        multiply_row_block<BlockOrder, 16>(*c, X.data(), Y.data(), n_vectors, i, first);
+                    }
+                    if (first + 8 <= n_vectors)
+                    {
+                        multiply_row_block<BlockOrder, 8>(*c, X.data(), Y.data(), n_vectors, i, first);
+                        first += 8;
+                    }
+                    if (first + 4 <= n_vectors)
+                    {
+                        multiply_row_block<BlockOrder, 4>(*c, X.data(), Y.data(), n_vectors, i, first);
+                        first += 4;
+                    }
+                    if (first + 2 <= n_vectors)
+                    {
+                        multiply_row_block<BlockOrder, 2>(*c, X.data(), Y.data(), n_vectors, i, first);
+                        first += 2;
+                    }
+                    if (first < n_vectors)
+                    {
+                        multiply_row_block<BlockOrder, 1>(*c, X.data(), Y.data(), n_vectors, i, first);
+                    }
+                } });
+        }
+        else
+        {
+            // Each column scatters into the rows of the result, with private partial results when threaded
+            auto scatter = [&](std::vector<T> &local, std::size_t col_start, std::size_t col_end)
+            {
+                for (std::size_t j = col_start; j < col_end; ++j)
+                {
+                    for (std::size_t k = c->offsets[j]; k < c->offsets[j + 1]; ++k)
+                    {
+                        const T value = static_cast<T>(c->values[k]);
+                        const std::size_t i = c->indices[k];
+                        for (std::size_t w = 0; w < n_vectors; ++w)
+                        {
+                            local[position(n_rows, i, w)] += value * X[position(n_columns, j, w)];
+                        }
+                    }
+                }
+            };
+
+            if (n_threads == 1)
+            {
+                scatter(Y, 0, n_columns);
+            }
+            else
             {
-                myfile.ignore(2048, '\n');
+                std::vector<std::vector<T>> partial(n_threads, std::vector<T>(Y.size(), 0));
+
+                parallel_for(n_threads, [&](std::size_t t)
+                             { scatter(partial[t], c->thread_bounds[t], c->thread_bounds[t + 1]); });
+
+                parallel_for(n_threads, [&](std::size_t t)
+                             {
+                    for (std::size_t p = Y.size() * t / n_threads; p < Y.size() * (t + 1) / n_threads; ++p)
+                    {
+                        T sum = 0;
+                        for (std::size_t q = 0; q < n_threads; ++q)
+                        {
+                            sum += partial[q][p];
+                        }
+                        Y[p] = sum;
+                    } });
             }
+        }
+
+        return Y;
+    }
 
-            // Read number of rows and columns
-            myfile >> n_rows >> n_columns >> n_lines;
-            resize(n_rows, n_columns);
+    template <typename T, StorageOrder Order, typename Index, typename Storage>
+    template <StorageOrder BlockOrder, std::size_t Width>
+    void Matrix<T, Order, Index, Storage>::multiply_row_block(const Compressed &c, const T *X, T *Y, std::size_t n_vectors, std::size_t i, std::size_t first) const
+    {
+        // Distance between the entries of a row of the block, and between consecutive vectors
+        constexpr bool row_block = (BlockOrder == StorageOrder::ROWMAJOR);
+        const std::size_t x_stride = row_block ? 1 : n_columns;
+        const std::size_t y_stride = row_block ? 1 : n_rows;
+        const std::size_t x_row = row_block ? n_vectors : 1;
+        const std::size_t y_row = row_block ? n_vectors : 1;
 
-            // fill the matrix with data
-            for (int l = 0; l < n_lines; l++)
+        T sum[Width] = {};
+        for (std::size_t k = c.offsets[i]; k < c.offsets[i + 1]; ++k)
+        {
+            const T value = static_cast<T>(c.values[k]);
+            const T *x = X + c.indices[k] * x_row + first * x_stride;
+            for (std::size_t w = 0; w < Width; ++w)
             {
-                myfile >> i >> j >> value;
-                this->operator()(i - 1, j - 1) = value;
+                sum[w] += value * x[w * x_stride];
             }
         }
 
-        myfile.close();
+        T *y = Y + i * y_row + first * y_stride;
+        for (std::size_t w = 0; w < Width; ++w)
+        {
+            y[w * y_stride] = sum[w];
+        }
+    }
+
+    template <typename T, StorageOrder Order, typename Index, typename Storage>
+    void Matrix<T, Order, Index, Storage>::read_from_file(const std::string &file_path)
+    {
+        MatrixMarketHeader header;
+        std::vector<Triplet<T>> entries = read_matrix_market<T>(file_path, n_threads, header);
+
+        // Replace the content of the matrix with the entries of the file
+        resize(header.n_rows, header.n_columns);
+        storage.template emplace<Uncompressed>().triplets = std::move(entries);
     };
-}
\ No newline at end of file
+
+    template <typename T, StorageOrder Order, typename Index, typename Storage>
+    void Matrix<T, Order, Index, Storage>::save_binary(const std::string &file_path) const
+    {
+        const Compressed *c = std::get_if<Compressed>(&storage);
+        if (!c)
+        {
+            throw std::runtime_error("Matrix must be compressed to be saved in binary format");
+        }
+
+        BinaryHeader header;
+        std::copy(std::begin(binary_magic), std::end(binary_magic), header.magic);
+        header.order = row_major ? 0 : 1;
+        header.value_size = sizeof(Storage);
+        header.index_size = sizeof(Index);
+        header.n_rows = n_rows;
+        header.n_columns = n_columns;
+        header.nnz = c->values.size();
+
+        std::ofstream myfile(file_path, std::ios::binary);
+        myfile.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        myfile.write(reinterpret_cast<const char *>(c->offsets.data()), c->offsets.size() * sizeof(Index));
+        myfile.write(reinterpret_cast<const char *>(c->indices.data()), c->indices.size() * sizeof(Index));
+        myfile.write(reinterpret_cast<const char *>(c->values.data()), c->values.size() * sizeof(Storage));
+
+        if (!myfile)
+        {
+            throw std::runtime_error("Cannot write file " + file_path);
+        }
+    };
+
+    template <typename T, StorageOrder Order, typename Index, typename Storage>
+    void Matrix<T, Order, Index, Storage>::set_compressed(std::size_t nrows, std::size_t ncolumns, std::vector<Index> offsets, std::vector<Index> indices, std::vector<Storage> values)
+    {
+        const std::size_t n_major = major_index(nrows, ncolumns);
+        if (offsets.size() != n_major + 1 || offsets[0] != 0 || offsets[n_major] != indices.size() || indices.size() != values.size())
+        {
+            throw std::runtime_error("Inconsistent compressed arrays");
+        }
+
+        resize(nrows, ncolumns);
+        Compressed &c = storage.template emplace<Compressed>();
+        c.offsets = std::move(offsets);
+        c.indices = std::move(indices);
+        c.values = std::move(values);
+        setup_threads();
+    }
+
+    template <typename T, StorageOrder Order, typename Index, typename Storage>
+    void Matrix<T, Order, Index, Storage>::read_binary(const std::string &file_path)
+    {
+        MappedFile file(file_path);
+        BinaryHeader header;
+
+        if (file.size() < sizeof(header))
+        {
+            throw std::runtime_error("Invalid binary matrix file " + file_path);
+        }
+        std::memcpy(&header, file.data(), sizeof(header));
+
+        const std::size_t n_major = major_index(header.n_rows, header.n_columns);
+        const std::size_t expected_size = sizeof(header) + (n_major + 1 + header.nnz) * sizeof(Index) + header.nnz * sizeof(Storage);
+
+        if (!std::equal(std::begin(binary_magic), std::end(binary_magic), header.magic) ||
+            header.order != (row_major ? 0u : 1u) ||
+            header.value_size != sizeof(Storage) || header.index_size != sizeof(Index) ||
+            file.size() != expected_size)
+        {
+            throw std::runtime_error("Binary matrix file " + file_path + " does not match the matrix type");
+        }
+
+        const char *data = file.data() + sizeof(header);
+        auto copy_array = [&data](auto &vector, std::size_t size)
+        {
+            using value_type = typename std::remove_reference_t<decltype(vector)>::value_type;
+            vector.resize(size);
+            std::memcpy(vector.data(), data, size * sizeof(value_type));
+            data += size * sizeof(value_type);
+        };
+
+        resize(header.n_rows, header.n_columns);
+        Compressed &c = storage.template emplace<Compressed>();
+        copy_array(c.offsets, n_major + 1);
+        copy_array(c.indices, header.nnz);
+        copy_array(c.values, header.nnz);
+        setup_threads();
+    };
+}
+
+#endif
@@ -0,0 +1,326 @@
+#ifndef MATRIXIO_HPP
+#define MATRIXIO_HPP
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "Parallel.hpp"
+#include "Triplet.hpp"
+
+namespace algebra
+{
+
+    /*!
+     * Read-only memory mapping of a whole file
+     */
+    class MappedFile
+    {
+    private:
+        void *address = nullptr;
+        std::size_t length = 0;
+
+    public:
+        /*!
+         * Map the file in memory
+         * @param file_path Path of the file
+         * @return std::runtime_error if the file cannot be opened or mapped
+         */
+        explicit MappedFile(const std::string &file_path)
+        {
+            int fd = ::open(file_path.c_str(), O_RDONLY);
+            if (fd < 0)
+            {
+                throw std::runtime_error("Cannot open file " + file_path);
+            }
+
+            struct stat info;
+            if (::fstat(fd, &info) != 0 || info.st_size == 0)
+            {
+                ::close(fd);
+                throw std::runtime_error("Cannot map empty file " + file_path);
+            }
+
+            length = static_cast<std::size_t>(info.st_size);
+            address = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            ::close(fd);
+
+            if (address == MAP_FAILED)
+            {
+                address = nullptr;
+                throw std::runtime_error("Cannot map file " + file_path);
+            }
+
+            ::madvise(address, length, MADV_SEQUENTIAL);
+        }
+
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        ~MappedFile()
+        {
+            if (address != nullptr)
+            {
+                ::munmap(address, length);
+            }
+        }
+
+        const char *data() const
+        {
+            return static_cast<const char *>(address);
+        }
+
+        std::size_t size() const
+        {
+            return length;
+        }
+    };
+
+    /*!
+     * Content of the banner and of the size line of a Matrix Market file
+     */
+    struct MatrixMarketHeader
+    {
+        std::string format = "coordinate"; // coordinate
+        std::string field = "real";        // real, double, integer or pattern
+        std::string symmetry = "general";  // general, symmetric or skew-symmetric
+        std::size_t n_rows = 0;
+        std::size_t n_columns = 0;
+        std::size_t n_entries = 0;
+    };
+
+    /*!
+     * Header of the binary format of a compressed matrix, followed by the offsets, indices and values arrays
+     */
+    struct BinaryHeader
+    {
+        char magic[8];
+        std::uint64_t order;      // 0 for ROWMAJOR, 1 for COLMAJOR
+        std::uint64_t value_size; // sizeof of the values
+        std::uint64_t index_size; // sizeof of the offsets and indices
+        std::uint64_t n_rows;
+        std::uint64_t n_columns;
+        std::uint64_t nnz;
+    };
+
+    inline constexpr char binary_magic[8] = {'P', 'A', 'C', 'S', 'C', 'S', 'X', '1'};
+
+    namespace detail
+    {
+        inline const char *skip_blanks(const char *p, const char *end)
+        {
+            while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+            {
+                ++p;
+            }
+            return p;
+        }
+
+        inline const char *next_line(const char *p, const char *end)
+        {
+            const char *newline = static_cast<const char *>(std::memchr(p, '\n', end - p));
+            return newline ? newline + 1 : end;
+        }
+
+        inline bool blank_line(const char *p, const char *end)
+        {
+            p = skip_blanks(p, end);
+            return p == end || *p == '\n';
+        }
+
+        /*!
+         * Parse the entries between p and end, which must start at the beginning of a line
+         * @return the number of entries read from the file, before the expansion of symmetric matrices
+         */
+        template <typename T>
+        std::size_t parse_entries(const char *p, const char *end, const MatrixMarketHeader &header, bool expand, std::vector<Triplet<T>> &entries)
+        {
+            const bool pattern = header.field == "pattern";
+            const bool integer = header.field == "integer";
+            const bool symmetric = expand && header.symmetry == "symmetric";
+            const bool skew = expand && header.symmetry == "skew-symmetric";
+            std::size_t n_read = 0;
+
+            while (p < end)
+            {
+                p = skip_blanks(p, end);
+                if (p == end)
+                {
+                    break;
+                }
+                if (*p == '\n' || *p == '%')
+                {
+                    p = next_line(p, end);
+                    continue;
+                }
+
+                std::size_t i = 0, j = 0;
+                T value = 1;
+                auto parsed = std::from_chars(p, end, i);
+                p = skip_blanks(parsed.ptr, end);
+                if (parsed.ec == std::errc())
+                {
+                    parsed = std::from_chars(p, end, j);
+                    p = skip_blanks(parsed.ptr, end);
+                }
+                if (parsed.ec == std::errc() && !pattern)
+                {
+                    p += (p < end && *p == '+');
+                    if (integer)
+                    {
+                        long long integer_value = 0;
+                        parsed = std::from_chars(p, end, integer_value);
+                        value = static_cast<T>(integer_value);
+                    }
+                    else
+                    {
+                        double real_value = 0;
+                        parsed = std::from_chars(p, end, real_value);
+                        value = static_cast<T>(real_value);
+                    }
+                    p = parsed.ptr;
+                }
+
+                if (parsed.ec != std::errc() || i == 0 || j == 0 || i > header.n_rows || j > header.n_columns)
+                {
+                    throw std::runtime_error("Malformed Matrix Market entry");
+                }
+
+                entries.push_back({i - 1, j - 1, value});
+                ++n_read;
+                if ((symmetric || skew) && i != j)
+                {
+                    entries.push_back({j - 1, i - 1, skew ? -value : value});
+                }
+
+                p = next_line(p, end);
+            }
+
+            return n_read;
+        }
+    }
+
+    /*!
+     * Read a file in Matrix Market coordinate format. The file is memory mapped and its
+     * lines are parsed in parallel, symmetric and skew-symmetric matrices are expanded
+     * @param file_path Path of the file
+     * @param n_threads Number of threads used to parse the entries
+     * @param header Filled with the banner and the size of the matrix
+     * @param expand If false the entries of symmetric and skew-symmetric matrices are returned as stored in the file
+     * @return the entries of the matrix, with 0-based indices
+     */
+    template <typename T>
+    std::vector<Triplet<T>> read_matrix_market(const std::string &file_path, std::size_t n_threads, MatrixMarketHeader &header, bool expand = true)
+    {
+        MappedFile file(file_path);
+        const char *p = file.data();
+        const char *end = p + file.size();
+
+        // Banner, a file without it is read as a general real matrix
+        const char *line_end = detail::next_line(p, end);
+        std::string banner(p, line_end);
+        std::transform(banner.begin(), banner.end(), banner.begin(), [](unsigned char c)
+                       { return std::tolower(c); });
+        if (banner.rfind("%%matrixmarket", 0) == 0)
+        {
+            std::istringstream words(banner);
+            std::string object;
+            words >> object >> object >> header.format >> header.field >> header.symmetry;
+
+            if (object != "matrix" || header.format != "coordinate")
+            {
+                throw std::runtime_error("Only Matrix Market matrices in coordinate format are supported");
+            }
+            if (header.field != "real" && header.field != "double" && header.field != "integer" && header.field != "pattern")
+            {
+                throw std::runtime_error("Unsupported Matrix Market field: " + header.field);
+            }
+            if (header.symmetry != "general" && header.symmetry != "symmetric" && header.symmetry != "skew-symmetric")
+            {
+                throw std::runtime_error("Unsupported Matrix Market symmetry: " + header.symmetry);
+            }
+            p = line_end;
+        }
+
+        // Ignore comments headers
+        while (p < end && (*p == '%' || detail::blank_line(p, end)))
+        {
+            p = detail::next_line(p, end);
+        }
+
+        // Read number of rows, columns and entries
+        line_end = detail::next_line(p, end);
+        std::istringstream size_line(std::string(p, line_end));
+        if (!(size_line >> header.n_rows >> header.n_columns >> header.n_entries))
+        {
+            throw std::runtime_error("Malformed Matrix Market size line");
+        }
+        p = line_end;
+
+        // Split the entries in chunks starting at the beginning of a line
+        n_threads = std::max<std::size_t>(1, std::min<std::size_t>(n_threads, (end - p) / 4096 + 1));
+        std::vector<const char *> bounds(n_threads + 1, end);
+        bounds[0] = p;
+        for (std::size_t t = 1; t < n_threads; ++t)
+        {
+            const char *guess = p + (end - p) * t / n_threads;
+            bounds[t] = std::max(bounds[t - 1], guess > p ? detail::next_line(guess - 1, end) : p);
+        }
+
+        expand = expand && header.symmetry != "general";
+        std::vector<std::vector<Triplet<T>>> chunks(n_threads);
+        std::vector<std::size_t> n_read(n_threads, 0);
+        std::vector<std::exception_ptr> errors(n_threads);
+
+        parallel_for(n_threads, [&](std::size_t t)
+                     {
+            try
+            {
+                chunks[t].reserve((expand ? 2 : 1) * header.n_entries / n_threads + 1);
+                n_read[t] = detail::parse_entries(bounds[t], bounds[t + 1], header, expand, chunks[t]);
+            }
+            catch (...)
+            {
+                errors[t] = std::current_exception();
+            } });
+
+        for (const auto &error : errors)
+        {
+            if (error)
+            {
+                std::rethrow_exception(error);
+            }
+        }
+
+        // Concatenate the chunks in file order
+        std::vector<std::size_t> positions(n_threads + 1, 0);
+        for (std::size_t t = 0; t < n_threads; ++t)
+        {
+            positions[t + 1] = positions[t] + chunks[t].size();
+        }
+
+        std::vector<Triplet<T>> entries(positions[n_threads]);
+        parallel_for(n_threads, [&](std::size_t t)
+                     { std::copy(chunks[t].begin(), chunks[t].end(), entries.begin() + positions[t]); });
+
+        if (std::accumulate(n_read.begin(), n_read.end(), std::size_t{0}) != header.n_entries)
+        {
+            throw std::runtime_error("Number of Matrix Market entries does not match the size line");
+        }
+
+        return entries;
+    }
+}
+
+#endif
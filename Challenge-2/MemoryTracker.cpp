@@ -0,0 +1,101 @@
+#include "MemoryTracker.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+    std::atomic<std::size_t> current_bytes{0};
+    std::atomic<std::size_t> peak_bytes{0};
+    std::atomic<std::size_t> n_allocations{0};
+
+    // The size of each block is stored in front of it, so that unsized delete can be tracked too
+    constexpr std::size_t header = alignof(std::max_align_t);
+
+    void *tracked_allocate(std::size_t size) noexcept
+    {
+        char *block = static_cast<char *>(std::malloc(size + header));
+        if (block == nullptr)
+        {
+            return nullptr;
+        }
+
+        *reinterpret_cast<std::size_t *>(block) = size;
+        n_allocations.fetch_add(1);
+        std::size_t now = current_bytes.fetch_add(size) + size;
+        std::size_t old_peak = peak_bytes.load();
+        while (now > old_peak && !peak_bytes.compare_exchange_weak(old_peak, now))
+        {
+        }
+
+        return block + header;
+    }
+
+    void tracked_deallocate(void *ptr) noexcept
+    {
+        if (ptr == nullptr)
+        {
+            return;
+        }
+
+        char *block = static_cast<char *>(ptr) - header;
+        current_bytes.fetch_sub(*reinterpret_cast<std::size_t *>(block));
+        std::free(block);
+    }
+}
+
+namespace algebra
+{
+    namespace memory
+    {
+        std::size_t current()
+        {
+            return current_bytes.load();
+        }
+
+        std::size_t peak()
+        {
+            return peak_bytes.load();
+        }
+
+        std::size_t allocations()
+        {
+            return n_allocations.load();
+        }
+
+        void reset_peak()
+        {
+            peak_bytes.store(current_bytes.load());
+        }
+    }
+}
+
+void *operator new(std::size_t size)
+{
+    void *ptr = tracked_allocate(size);
+    if (ptr == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+    return tracked_allocate(size);
+}
+
+void operator delete(void *ptr) noexcept
+{
+    tracked_deallocate(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept
+{
+    tracked_deallocate(ptr);
+}
+
+void operator delete(void *ptr, const std::nothrow_t &) noexcept
+{
+    tracked_deallocate(ptr);
+}
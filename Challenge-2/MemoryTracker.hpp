@@ -0,0 +1,35 @@
+#ifndef MEMORYTRACKER_HPP
+#define MEMORYTRACKER_HPP
+
+#include <cstddef>
+
+namespace algebra
+{
+    /*!
+     * Heap usage counters, updated by the replacement of the global operator new and delete in MemoryTracker.cpp
+     */
+    namespace memory
+    {
+        /*!
+         * Bytes currently allocated on the heap
+         */
+        std::size_t current();
+
+        /*!
+         * Highest value reached by current() since the last call to reset_peak()
+         */
+        std::size_t peak();
+
+        /*!
+         * Number of allocations since the start of the program
+         */
+        std::size_t allocations();
+
+        /*!
+         * Reset the peak to the bytes currently allocated
+         */
+        void reset_peak();
+    }
+}
+
+#endif
@@ -0,0 +1,218 @@
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace algebra
+{
+
+    /*!
+     * Split the range [0, n) in n_parts contiguous blocks holding roughly the same number of non-zero elements
+     * @param offsets Prefix sum of the non-zero elements (size n + 1), like the offsets vector of a compressed matrix
+     * @param n_parts Number of blocks
+     * @return a vector of size n_parts + 1 containing the boundaries of the blocks
+     */
+    template <typename Index>
+    std::vector<std::size_t> balanced_partition(const std::vector<Index> &offsets, std::size_t n_parts)
+    {
+        const std::size_t n = offsets.empty() ? 0 : offsets.size() - 1;
+        std::vector<std::size_t> bounds(n_parts + 1, n);
+        bounds[0] = 0;
+
+        if (n == 0)
+        {
+            return bounds;
+        }
+
+        const std::size_t nnz = offsets[n];
+
+        for (std::size_t p = 1; p < n_parts; ++p)
+        {
+            // First block whose starting offset reaches the p-th fraction of the non-zero elements
+            std::size_t target = nnz * p / n_parts;
+            auto it = std::lower_bound(offsets.begin(), offsets.end() - 1, target);
+            bounds[p] = std::max<std::size_t>(bounds[p - 1], it - offsets.begin());
+        }
+
+        return bounds;
+    }
+
+    /*!
+     * Pool of persistent worker threads used by parallel_for, so that running a parallel loop
+     * neither creates threads nor allocates memory once the pool has grown to the requested size
+     */
+    class ThreadPool
+    {
+    private:
+        std::vector<std::thread> workers;
+        std::mutex job_mutex; // one job at a time
+        std::mutex mutex;
+        std::condition_variable start_condition;
+        std::condition_variable done_condition;
+
+        // Current job, run by the calling thread (index 0) and by workers 1, ..., n_active
+        void (*task)(void *, std::size_t) = nullptr;
+        void *context = nullptr;
+        std::size_t n_active = 0;
+        std::size_t pending = 0;
+        std::size_t generation = 0;
+        bool stop = false;
+        std::exception_ptr worker_error; // first exception thrown by a worker in the current job
+
+        // True on the workers and on a calling thread while it runs its part of a job
+        static bool &inside_job()
+        {
+            static thread_local bool inside = false;
+            return inside;
+        }
+
+        void worker_loop(std::size_t id, std::size_t seen)
+        {
+            inside_job() = true;
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true)
+            {
+                start_condition.wait(lock, [&]()
+                                     { return stop || generation != seen; });
+                if (stop)
+                {
+                    return;
+                }
+                seen = generation;
+                if (id > n_active)
+                {
+                    continue;
+                }
+
+                lock.unlock();
+                std::exception_ptr error;
+                try
+                {
+                    task(context, id);
+                }
+                catch (...)
+                {
+                    error = std::current_exception();
+                }
+                lock.lock();
+
+                if (error && !worker_error)
+                {
+                    worker_error = error;
+                }
+
+                if (--pending == 0)
+                {
+                    done_condition.notify_one();
+                }
+            }
+        }
+
+    public:
+        ThreadPool() = default;
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        ~ThreadPool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stop = true;
+            }
+            start_condition.notify_all();
+            for (auto &worker : workers)
+            {
+                worker.join();
+            }
+        }
+
+        /*!
+         * Pool shared by all the parallel loops
+         */
+        static ThreadPool &instance()
+        {
+            static ThreadPool pool;
+            return pool;
+        }
+
+        /*!
+         * Run job(job_context, t) for t = 0, ..., n_threads - 1 and wait for all of them.
+         * Calls from inside a job, on a worker or on the calling thread, run serially on that thread.
+         * If some calls throw, the exception of the calling thread, or else the first one of a worker, is rethrown
+         */
+        void run(std::size_t n_threads, void (*job)(void *, std::size_t), void *job_context)
+        {
+            if (n_threads <= 1 || inside_job())
+            {
+                for (std::size_t t = 0; t < n_threads; ++t)
+                {
+                    job(job_context, t);
+                }
+                return;
+            }
+
+            std::lock_guard<std::mutex> job_lock(job_mutex);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                while (workers.size() < n_threads - 1)
+                {
+                    workers.emplace_back(&ThreadPool::worker_loop, this, workers.size() + 1, generation);
+                }
+                task = job;
+                context = job_context;
+                n_active = n_threads - 1;
+                pending = n_threads - 1;
+                worker_error = nullptr;
+                ++generation;
+            }
+            start_condition.notify_all();
+
+            std::exception_ptr error;
+            inside_job() = true;
+            try
+            {
+                job(job_context, 0);
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+            inside_job() = false;
+
+            std::unique_lock<std::mutex> lock(mutex);
+            done_condition.wait(lock, [&]()
+                                { return pending == 0; });
+            if (!error)
+            {
+                error = std::exchange(worker_error, nullptr);
+            }
+            if (error)
+            {
+                std::rethrow_exception(error);
+            }
+        }
+    };
+
+    /*!
+     * Run f(t) for t = 0, ..., n_threads - 1, each call on its own thread of the ThreadPool.
+     * The call with t = 0 runs on the calling thread
+     * @param n_threads Number of threads
+     * @param f Callable taking the thread index
+     */
+    template <typename Function>
+    void parallel_for(std::size_t n_threads, Function &&f)
+    {
+        using F = std::remove_reference_t<Function>;
+        ThreadPool::instance().run(std::max<std::size_t>(1, n_threads), [](void *context, std::size_t t)
+                                   { (*static_cast<F *>(context))(t); }, const_cast<void *>(static_cast<const void *>(&f)));
+    }
+}
+
+#endif
@@ -0,0 +1,257 @@
+#ifndef PRECONDITIONERS_HPP
+#define PRECONDITIONERS_HPP
+
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "Matrix.hpp"
+#include "SymmetricMatrix.hpp"
+
+namespace algebra
+{
+
+    /*!
+     * No preconditioning, z = r
+     */
+    template <typename T>
+    class IdentityPreconditioner
+    {
+    public:
+        /*!
+         * Apply the preconditioner, z = M^-1 r
+         * @param r input vector
+         * @param z output vector, of the same size of r
+         */
+        void apply(std::span<const T> r, std::span<T> z) const
+        {
+            std::copy(r.begin(), r.end(), z.begin());
+        }
+    };
+
+    /*!
+     * Jacobi preconditioner, M = diag(A)
+     */
+    template <typename T>
+    class JacobiPreconditioner
+    {
+    private:
+        std::vector<T> inverse_diagonal;
+
+    public:
+        /*!
+         * Store the inverse of the diagonal of a square matrix
+         * @param matrix Square matrix
+         * @return std::runtime_error if the matrix is not square or has a zero on the diagonal
+         */
+        template <StorageOrder Order, typename Index, typename Storage>
+        explicit JacobiPreconditioner(const Matrix<T, Order, Index, Storage> &matrix);
+
+        /*!
+         * Store the inverse of the diagonal of a symmetric matrix, read from its separate diagonal
+         * @param matrix Symmetric matrix
+         * @return std::runtime_error if the matrix has a zero on the diagonal
+         */
+        template <typename Index, typename Storage>
+        explicit JacobiPreconditioner(const SymmetricMatrix<T, Index, Storage> &matrix);
+
+        /*!
+         * Apply the preconditioner, z = M^-1 r
+         * @param r input vector
+         * @param z output vector, of the same size of r
+         */
+        void apply(std::span<const T> r, std::span<T> z) const
+        {
+            for (std::size_t i = 0; i < inverse_diagonal.size(); ++i)
+            {
+                z[i] = inverse_diagonal[i] * r[i];
+            }
+        }
+    };
+
+    /*!
+     * Incomplete LU factorization without fill-in, ILU(0): L and U have the pattern of the matrix,
+     * L with a unit diagonal. The factors are stored together in CSR format
+     */
+    template <typename T>
+    class ILU0Preconditioner
+    {
+    private:
+        std::vector<std::size_t> offsets;
+        std::vector<std::size_t> indices;
+        std::vector<T> values;
+        std::vector<std::size_t> diagonal; // position of the diagonal element of each row
+
+    public:
+        /*!
+         * Factorize a square compressed matrix
+         * @param matrix Square compressed matrix, with all the diagonal elements stored
+         * @return std::runtime_error if the matrix is not compressed and square, or a pivot is missing or zero
+         */
+        template <StorageOrder Order, typename Index, typename Storage>
+        explicit ILU0Preconditioner(const Matrix<T, Order, Index, Storage> &matrix);
+
+        /*!
+         * Apply the preconditioner, z = U^-1 L^-1 r
+         * @param r input vector
+         * @param z output vector, of the same size of r
+         */
+        void apply(std::span<const T> r, std::span<T> z) const;
+    };
+
+    /*
+     * ***************************************************************************
+     * Definitions
+     * ***************************************************************************
+     */
+    template <typename T>
+    template <StorageOrder Order, typename Index, typename Storage>
+    JacobiPreconditioner<T>::JacobiPreconditioner(const Matrix<T, Order, Index, Storage> &matrix)
+    {
+        if (matrix.get_rows() != matrix.get_columns())
+        {
+            throw std::runtime_error("Jacobi preconditioner of a non square matrix");
+        }
+
+        inverse_diagonal.resize(matrix.get_rows());
+        for (std::size_t i = 0; i < inverse_diagonal.size(); ++i)
+        {
+            T diagonal = matrix(i, i);
+            if (diagonal == T(0))
+            {
+                throw std::runtime_error("Zero on the diagonal of the Jacobi preconditioner");
+            }
+            inverse_diagonal[i] = T(1) / diagonal;
+        }
+    }
+
+    template <typename T>
+    template <typename Index, typename Storage>
+    JacobiPreconditioner<T>::JacobiPreconditioner(const SymmetricMatrix<T, Index, Storage> &matrix)
+    {
+        const auto &diagonal = matrix.get_diagonal();
+        inverse_diagonal.resize(diagonal.size());
+        for (std::size_t i = 0; i < inverse_diagonal.size(); ++i)
+        {
+            if (diagonal[i] == Storage(0))
+            {
+                throw std::runtime_error("Zero on the diagonal of the Jacobi preconditioner");
+            }
+            inverse_diagonal[i] = T(1) / static_cast<T>(diagonal[i]);
+        }
+    }
+
+    template <typename T>
+    template <StorageOrder Order, typename Index, typename Storage>
+    ILU0Preconditioner<T>::ILU0Preconditioner(const Matrix<T, Order, Index, Storage> &matrix)
+    {
+        if (!matrix.is_compressed() || matrix.get_rows() != matrix.get_columns())
+        {
+            throw std::runtime_error("ILU(0) of a non square or non compressed matrix");
+        }
+
+        const std::size_t n = matrix.get_rows();
+        const auto &matrix_offsets = matrix.get_offsets();
+        const auto &matrix_indices = matrix.get_indices();
+        const auto &matrix_values = matrix.get_values();
+
+        offsets.assign(matrix_offsets.begin(), matrix_offsets.end());
+        indices.resize(matrix_indices.size());
+        values.resize(matrix_values.size());
+        if (Order == StorageOrder::ROWMAJOR)
+        {
+            std::copy(matrix_indices.begin(), matrix_indices.end(), indices.begin());
+            std::copy(matrix_values.begin(), matrix_values.end(), values.begin());
+        }
+        else
+        {
+            // CSC to CSR with a counting sort on the rows, columns are visited in order so the rows stay sorted
+            std::fill(offsets.begin(), offsets.end(), 0);
+            for (auto row : matrix_indices)
+            {
+                offsets[row + 1]++;
+            }
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                offsets[i + 1] += offsets[i];
+            }
+            std::vector<std::size_t> next(offsets.begin(), offsets.end() - 1);
+            for (std::size_t j = 0; j < n; ++j)
+            {
+                for (std::size_t k = matrix_offsets[j]; k < matrix_offsets[j + 1]; ++k)
+                {
+                    std::size_t position = next[matrix_indices[k]]++;
+                    indices[position] = j;
+                    values[position] = static_cast<T>(matrix_values[k]);
+                }
+            }
+        }
+
+        // Row-wise (IKJ) elimination restricted to the pattern, position[j] is the index of column j in the current row
+        constexpr std::size_t none = static_cast<std::size_t>(-1);
+        std::vector<std::size_t> position(n, none);
+        diagonal.resize(n);
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            for (std::size_t k = offsets[i]; k < offsets[i + 1]; ++k)
+            {
+                position[indices[k]] = k;
+            }
+
+            std::size_t k = offsets[i];
+            for (; k < offsets[i + 1] && indices[k] < i; ++k)
+            {
+                const std::size_t pivot_row = indices[k];
+                values[k] /= values[diagonal[pivot_row]];
+                for (std::size_t p = diagonal[pivot_row] + 1; p < offsets[pivot_row + 1]; ++p)
+                {
+                    if (position[indices[p]] != none)
+                    {
+                        values[position[indices[p]]] -= values[k] * values[p];
+                    }
+                }
+            }
+
+            if (k == offsets[i + 1] || indices[k] != i || values[k] == T(0))
+            {
+                throw std::runtime_error("Missing or zero pivot in ILU(0)");
+            }
+            diagonal[i] = k;
+
+            for (std::size_t p = offsets[i]; p < offsets[i + 1]; ++p)
+            {
+                position[indices[p]] = none;
+            }
+        }
+    }
+
+    template <typename T>
+    void ILU0Preconditioner<T>::apply(std::span<const T> r, std::span<T> z) const
+    {
+        const std::size_t n = diagonal.size();
+
+        // Forward substitution with the unit lower triangle
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            T sum = r[i];
+            for (std::size_t k = offsets[i]; k < diagonal[i]; ++k)
+            {
+                sum -= values[k] * z[indices[k]];
+            }
+            z[i] = sum;
+        }
+
+        // Backward substitution with the upper triangle
+        for (std::size_t i = n; i-- > 0;)
+        {
+            T sum = z[i];
+            for (std::size_t k = diagonal[i] + 1; k < offsets[i + 1]; ++k)
+            {
+                sum -= values[k] * z[indices[k]];
+            }
+            z[i] = sum / values[diagonal[i]];
+        }
+    }
+}
+
+#endif
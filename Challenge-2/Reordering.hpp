@@ -0,0 +1,241 @@
+#ifndef REORDERING_HPP
+#define REORDERING_HPP
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+#include "Matrix.hpp"
+
+namespace algebra
+{
+
+    /*!
+     * Reverse Cuthill-McKee ordering of the graph of A + A^T, which reduces the bandwidth of the matrix.
+     * Each connected component is numbered by a breadth-first search from a pseudo-peripheral node,
+     * visiting the neighbours by increasing degree, and the whole numbering is then reversed
+     * @param offsets Offsets of the rows (or columns) of a square compressed matrix
+     * @param indices Indices of the compressed matrix, sorted within each row (column)
+     * @return the permutation from the new to the old numbering, to be passed to Matrix::permute()
+     */
+    template <typename Index>
+    std::vector<std::size_t> reverse_cuthill_mckee(const std::vector<Index> &offsets, const std::vector<Index> &indices);
+
+    /*!
+     * Reverse Cuthill-McKee ordering of a square compressed matrix
+     * @param matrix Compressed matrix, its pattern is symmetrized
+     * @return the permutation from the new to the old numbering, to be passed to Matrix::permute()
+     * @return std::runtime_error if the matrix is not compressed and square
+     */
+    template <typename T, StorageOrder Order, typename Index, typename Storage>
+    std::vector<std::size_t> reverse_cuthill_mckee(const Matrix<T, Order, Index, Storage> &matrix)
+    {
+        if (!matrix.is_compressed() || matrix.get_rows() != matrix.get_columns())
+        {
+            throw std::runtime_error("Only square compressed matrices can be reordered");
+        }
+        return reverse_cuthill_mckee(matrix.get_offsets(), matrix.get_indices());
+    }
+
+    /*!
+     * Move a vector to the new numbering of a permuted matrix: result[i] = v[permutation[i]]
+     * @param v Vector in the old numbering
+     * @param permutation New to old numbering
+     * @return std::runtime_error if permutation is not a permutation of 0, ..., v.size() - 1
+     */
+    template <typename T>
+    std::vector<T> permute_vector(const std::vector<T> &v, const std::vector<std::size_t> &permutation)
+    {
+        check_permutation(permutation, v.size());
+        std::vector<T> result(v.size());
+        for (std::size_t i = 0; i < v.size(); ++i)
+        {
+            result[i] = v[permutation[i]];
+        }
+        return result;
+    }
+
+    /*!
+     * Move a vector back to the old numbering: result[permutation[i]] = v[i]
+     * @param v Vector in the new numbering
+     * @param permutation New to old numbering
+     * @return std::runtime_error if permutation is not a permutation of 0, ..., v.size() - 1
+     */
+    template <typename T>
+    std::vector<T> unpermute_vector(const std::vector<T> &v, const std::vector<std::size_t> &permutation)
+    {
+        check_permutation(permutation, v.size());
+        std::vector<T> result(v.size());
+        for (std::size_t i = 0; i < v.size(); ++i)
+        {
+            result[permutation[i]] = v[i];
+        }
+        return result;
+    }
+
+    /*
+     * ***************************************************************************
+     * Definitions
+     * ***************************************************************************
+     */
+    template <typename Index>
+    std::vector<std::size_t> reverse_cuthill_mckee(const std::vector<Index> &offsets, const std::vector<Index> &indices)
+    {
+        const std::size_t n = offsets.empty() ? 0 : offsets.size() - 1;
+        constexpr std::size_t none = static_cast<std::size_t>(-1);
+
+        // Adjacency of A + A^T without the diagonal, one list per node
+        std::vector<std::size_t> adjacency_offsets(n + 1, 0);
+        for (std::size_t m = 0; m < n; ++m)
+        {
+            for (std::size_t k = offsets[m]; k < offsets[m + 1]; ++k)
+            {
+                if (indices[k] != m)
+                {
+                    adjacency_offsets[m + 1]++;
+                    adjacency_offsets[indices[k] + 1]++;
+                }
+            }
+        }
+        for (std::size_t m = 0; m < n; ++m)
+        {
+            adjacency_offsets[m + 1] += adjacency_offsets[m];
+        }
+
+        std::vector<std::size_t> adjacency(adjacency_offsets[n]);
+        std::vector<std::size_t> next(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+        for (std::size_t m = 0; m < n; ++m)
+        {
+            for (std::size_t k = offsets[m]; k < offsets[m + 1]; ++k)
+            {
+                if (indices[k] != m)
+                {
+                    adjacency[next[m]++] = indices[k];
+                    adjacency[next[indices[k]]++] = m;
+                }
+            }
+        }
+
+        // Remove the edges present in both A and A^T
+        std::vector<std::size_t> degree(n, 0);
+        std::size_t length = 0;
+        for (std::size_t m = 0; m < n; ++m)
+        {
+            auto first = adjacency.begin() + adjacency_offsets[m];
+            auto last = adjacency.begin() + adjacency_offsets[m + 1];
+            std::sort(first, last);
+            last = std::unique(first, last);
+            degree[m] = last - first;
+            std::copy(first, last, adjacency.begin() + length);
+            adjacency_offsets[m] = length;
+            length += degree[m];
+        }
+        adjacency_offsets[n] = length;
+
+        auto neighbours = [&](std::size_t node)
+        {
+            return std::pair{adjacency.begin() + adjacency_offsets[node], adjacency.begin() + adjacency_offsets[node] + degree[node]};
+        };
+
+        // Breadth-first search from root over the unnumbered nodes, it returns the last level
+        // and the number of levels; level holds the stamp of the last search that reached each node
+        std::vector<std::size_t> level(n, none);
+        std::vector<std::size_t> queue;
+        queue.reserve(n);
+        std::vector<bool> numbered(n, false);
+        std::size_t stamp = 0;
+        auto level_structure = [&](std::size_t root, std::vector<std::size_t> &last_level)
+        {
+            ++stamp;
+            queue.clear();
+            queue.push_back(root);
+            level[root] = stamp;
+            std::size_t depth = 0;
+            std::size_t level_begin = 0;
+            while (level_begin < queue.size())
+            {
+                std::size_t level_end = queue.size();
+                for (std::size_t q = level_begin; q < level_end; ++q)
+                {
+                    auto [first, last] = neighbours(queue[q]);
+                    for (auto it = first; it != last; ++it)
+                    {
+                        if (!numbered[*it] && level[*it] != stamp)
+                        {
+                            level[*it] = stamp;
+                            queue.push_back(*it);
+                        }
+                    }
+                }
+                last_level.assign(queue.begin() + level_begin, queue.begin() + level_end);
+                level_begin = level_end;
+                ++depth;
+            }
+            return depth;
+        };
+
+        std::vector<std::size_t> order;
+        order.reserve(n);
+        std::vector<std::size_t> last_level;
+        std::vector<std::size_t> candidates;
+
+        // Nodes sorted by degree, each component starts from its node of minimum degree
+        std::vector<std::size_t> by_degree(n);
+        for (std::size_t m = 0; m < n; ++m)
+        {
+            by_degree[m] = m;
+        }
+        std::stable_sort(by_degree.begin(), by_degree.end(), [&](std::size_t a, std::size_t b)
+                         { return degree[a] < degree[b]; });
+
+        for (std::size_t start : by_degree)
+        {
+            if (numbered[start])
+            {
+                continue;
+            }
+
+            // Pseudo-peripheral node (George and Liu): move to the node of minimum degree of the last level
+            // as long as the number of levels grows
+            std::size_t root = start;
+            std::size_t depth = level_structure(root, last_level);
+            while (true)
+            {
+                candidates = last_level;
+                std::size_t candidate = *std::min_element(candidates.begin(), candidates.end(), [&](std::size_t a, std::size_t b)
+                                                          { return degree[a] < degree[b]; });
+                std::size_t candidate_depth = level_structure(candidate, last_level);
+                if (candidate_depth <= depth)
+                {
+                    break;
+                }
+                root = candidate;
+                depth = candidate_depth;
+            }
+
+            // Cuthill-McKee numbering of the component, neighbours by increasing degree
+            std::size_t component_begin = order.size();
+            order.push_back(root);
+            numbered[root] = true;
+            for (std::size_t q = component_begin; q < order.size(); ++q)
+            {
+                std::size_t children_begin = order.size();
+                auto [first, last] = neighbours(order[q]);
+                for (auto it = first; it != last; ++it)
+                {
+                    if (!numbered[*it])
+                    {
+                        numbered[*it] = true;
+                        order.push_back(*it);
+                    }
+                }
+                std::stable_sort(order.begin() + children_begin, order.end(), [&](std::size_t a, std::size_t b)
+                                 { return degree[a] < degree[b]; });
+            }
+        }
+
+        std::reverse(order.begin(), order.end());
+        return order;
+    }
+}
+
+#endif
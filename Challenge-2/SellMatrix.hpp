@@ -0,0 +1,372 @@
+#ifndef SELLMATRIX_HPP
+#define SELLMATRIX_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+#include "Matrix.hpp"
+#include "Parallel.hpp"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define SELL_X86_KERNELS
+#endif
+
+namespace algebra
+{
+
+    /*!
+     * Kernels for the SELL-C-sigma matrix-vector multiplication
+     */
+    enum class SellKernel
+    {
+        SCALAR, // portable loop over the slices
+        AVX2,   // 4 double lanes, gathers of x
+        AVX512  // 8 double lanes, gathers of x
+    };
+
+    /*!
+     * Sparse matrix in SELL-C-sigma format: rows are sorted by decreasing length within windows of sigma rows,
+     * then grouped in slices of C rows stored column by column and padded to the longest row of the slice.
+     * Each column of a slice fills a SIMD register, so the multiplication processes C rows at a time.
+     * The AVX2/AVX-512 kernels are selected at runtime for double, otherwise the portable kernel is used
+     *   @tparam T type of the element in the matrix
+     *   @tparam C number of rows of a slice, a multiple of the SIMD width (8 fits both AVX2 and AVX-512 for double)
+     */
+    template <typename T, std::size_t C = 8>
+    class SellMatrix
+    {
+        static_assert(C % 8 == 0, "The slice height must be a multiple of 8");
+
+    private:
+        std::size_t n_rows = 0;
+        std::size_t n_columns = 0;
+        std::size_t n_threads = 1;
+        SellKernel kernel = SellKernel::SCALAR;
+
+        // Start of each slice in values and columns, the width of slice s is (slice_offsets[s + 1] - slice_offsets[s]) / C
+        std::vector<std::size_t> slice_offsets;
+        std::vector<std::int32_t> columns;
+        std::vector<T> values;
+
+        // Original index of the row stored in position r, padded with n_rows up to a multiple of C
+        std::vector<std::size_t> permutation;
+
+    public:
+        /*!
+         * Build the SELL-C-sigma storage from a compressed row-major matrix
+         * @param matrix Compressed row-major matrix
+         * @param sigma Size of the windows in which rows are sorted by length, a multiple of C (1 disables sorting)
+         * @return std::runtime_error if the matrix is not compressed, std::overflow_error if it has more than 2^31 - 1 columns
+         */
+        template <typename Index, typename Storage>
+        explicit SellMatrix(const Matrix<T, StorageOrder::ROWMAJOR, Index, Storage> &matrix, std::size_t sigma = 32 * C);
+
+        /*!
+         * Select the kernel of the multiplication
+         * @param new_kernel Kernel to use, it falls back to the portable one if the cpu does not support it
+         */
+        void set_kernel(SellKernel new_kernel);
+
+        /*!
+         * Get the kernel of the multiplication, the best one supported by the cpu unless set_kernel() was called
+         */
+        SellKernel get_kernel() const
+        {
+            return kernel;
+        }
+
+        /*!
+         * Check if a kernel can run on this cpu
+         */
+        static bool supports(SellKernel candidate);
+
+        /*!
+         * Set the number of threads used by the multiplication, slices are split among threads
+         * @param nthreads Number of threads, 0 selects the hardware concurrency
+         */
+        void set_threads(std::size_t nthreads)
+        {
+            n_threads = nthreads > 0 ? nthreads : std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        /*!
+         * Get the number of stored elements, padding included
+         */
+        std::size_t get_stored() const
+        {
+            return values.size();
+        }
+
+        /*!
+         * Matrix-vector multiplication operatoration
+         * @param v vector to permform the matrix-vector moltiplication
+         * @return a vector containing the result of the operation
+         */
+        std::vector<T> operator*(const std::vector<T> &v) const;
+
+    private:
+        /*!
+         * Multiply the slices from first to last with the portable kernel
+         */
+        void multiply_scalar(const T *v, T *result, std::size_t first, std::size_t last) const;
+
+#ifdef SELL_X86_KERNELS
+        /*!
+         * Multiply the slices from first to last with the AVX2 kernel
+         */
+        __attribute__((target("avx2,fma"))) void multiply_avx2(const T *v, T *result, std::size_t first, std::size_t last) const;
+
+        /*!
+         * Multiply the slices from first to last with the AVX-512 kernel
+         */
+        __attribute__((target("avx512f"))) void multiply_avx512(const T *v, T *result, std::size_t first, std::size_t last) const;
+#endif
+    };
+
+    /*
+     * ***************************************************************************
+     * Definitions
+     * ***************************************************************************
+     */
+    template <typename T, std::size_t C>
+    template <typename Index, typename Storage>
+    SellMatrix<T, C>::SellMatrix(const Matrix<T, StorageOrder::ROWMAJOR, Index, Storage> &matrix, std::size_t sigma)
+        : n_rows{matrix.get_rows()}, n_columns{matrix.get_columns()}, n_threads{matrix.get_threads()}
+    {
+        if (!matrix.is_compressed())
+        {
+            throw std::runtime_error("Matrix must be compressed to build the SELL-C-sigma storage");
+        }
+        // Column indices are 32 bit signed integers, as required by the gather instructions
+        if (n_columns > static_cast<std::size_t>(std::numeric_limits<std::int32_t>::max()))
+        {
+            throw std::overflow_error("Too many columns for the SELL-C-sigma storage");
+        }
+
+        const auto &offsets = matrix.get_offsets();
+        const auto &indices = matrix.get_indices();
+        const auto &data = matrix.get_values();
+        auto row_length = [&offsets](std::size_t i) -> std::size_t
+        { return offsets[i + 1] - offsets[i]; };
+
+        // Sort the rows by decreasing length within each window of sigma rows
+        const std::size_t n_slices = (n_rows + C - 1) / C;
+        sigma = std::max<std::size_t>(1, sigma);
+        permutation.resize(n_slices * C);
+        std::iota(permutation.begin(), permutation.begin() + n_rows, std::size_t{0});
+        std::fill(permutation.begin() + n_rows, permutation.end(), n_rows);
+        for (std::size_t start = 0; start < n_rows && sigma > 1; start += sigma)
+        {
+            std::stable_sort(permutation.begin() + start, permutation.begin() + std::min(n_rows, start + sigma),
+                             [&](std::size_t a, std::size_t b)
+                             { return row_length(a) > row_length(b); });
+        }
+
+        // Width of each slice is the length of its longest row
+        slice_offsets.assign(n_slices + 1, 0);
+        for (std::size_t s = 0; s < n_slices; ++s)
+        {
+            std::size_t width = 0;
+            for (std::size_t r = s * C; r < (s + 1) * C && permutation[r] < n_rows; ++r)
+            {
+                width = std::max(width, row_length(permutation[r]));
+            }
+            slice_offsets[s + 1] = slice_offsets[s] + width * C;
+        }
+
+        // Fill the slices column by column, padding with zeros that point to the first column
+        columns.assign(slice_offsets[n_slices], 0);
+        values.assign(slice_offsets[n_slices], 0);
+        for (std::size_t s = 0; s < n_slices; ++s)
+        {
+            for (std::size_t r = 0; r < C && permutation[s * C + r] < n_rows; ++r)
+            {
+                std::size_t i = permutation[s * C + r];
+                for (std::size_t k = offsets[i]; k < offsets[i + 1]; ++k)
+                {
+                    std::size_t position = slice_offsets[s] + (k - offsets[i]) * C + r;
+                    columns[position] = static_cast<std::int32_t>(indices[k]);
+                    values[position] = static_cast<T>(data[k]);
+                }
+            }
+        }
+
+        // Best kernel supported by the cpu
+        for (SellKernel candidate : {SellKernel::AVX512, SellKernel::AVX2})
+        {
+            if (supports(candidate))
+            {
+                kernel = candidate;
+                break;
+            }
+        }
+    }
+
+    template <typename T, std::size_t C>
+    bool SellMatrix<T, C>::supports(SellKernel candidate)
+    {
+        if (candidate == SellKernel::SCALAR)
+        {
+            return true;
+        }
+#ifdef SELL_X86_KERNELS
+        if (std::is_same_v<T, double>)
+        {
+            __builtin_cpu_init();
+            if (candidate == SellKernel::AVX2)
+            {
+                return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+            }
+            return __builtin_cpu_supports("avx512f");
+        }
+#endif
+        return false;
+    }
+
+    template <typename T, std::size_t C>
+    void SellMatrix<T, C>::set_kernel(SellKernel new_kernel)
+    {
+        kernel = supports(new_kernel) ? new_kernel : SellKernel::SCALAR;
+    }
+
+    template <typename T, std::size_t C>
+    std::vector<T> SellMatrix<T, C>::operator*(const std::vector<T> &v) const
+    {
+        if (v.size() != n_columns)
+        {
+            throw std::runtime_error("Non comforming size for the input vector");
+        }
+
+        // One extra entry collects the padding rows of the last slice
+        std::vector<T> result(n_rows + 1, 0);
+        const std::size_t n_slices = slice_offsets.size() - 1;
+
+        parallel_for(n_threads, [&](std::size_t t)
+                     {
+            std::size_t first = n_slices * t / n_threads;
+            std::size_t last = n_slices * (t + 1) / n_threads;
+            switch (kernel)
+            {
+#ifdef SELL_X86_KERNELS
+            case SellKernel::AVX512:
+                multiply_avx512(v.data(), result.data(), first, last);
+                break;
+            case SellKernel::AVX2:
+                multiply_avx2(v.data(), result.data(), first, last);
+                break;
+#endif
+            default:
+                multiply_scalar(v.data(), result.data(), first, last);
+                break;
+            } });
+
+        result.pop_back();
+        return result;
+    }
+
+    template <typename T, std::size_t C>
+    void SellMatrix<T, C>::multiply_scalar(const T *v, T *result, std::size_t first, std::size_t last) const
+    {
+        for (std::size_t s = first; s < last; ++s)
+        {
+            T sum[C] = {};
+            for (std::size_t k = slice_offsets[s]; k < slice_offsets[s + 1]; k += C)
+            {
+                for (std::size_t r = 0; r < C; ++r)
+                {
+                    sum[r] += values[k + r] * v[columns[k + r]];
+                }
+            }
+            for (std::size_t r = 0; r < C; ++r)
+            {
+                result[permutation[s * C + r]] = sum[r];
+            }
+        }
+    }
+
+#ifdef SELL_X86_KERNELS
+    template <typename T, std::size_t C>
+    __attribute__((target("avx2,fma"))) void SellMatrix<T, C>::multiply_avx2(const T *v, T *result, std::size_t first, std::size_t last) const
+    {
+        if constexpr (std::is_same_v<T, double>)
+        {
+            const __m256d all_lanes = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+            for (std::size_t s = first; s < last; ++s)
+            {
+                __m256d sum[C / 4];
+                for (auto &lane : sum)
+                {
+                    lane = _mm256_setzero_pd();
+                }
+                for (std::size_t k = slice_offsets[s]; k < slice_offsets[s + 1]; k += C)
+                {
+                    for (std::size_t r = 0; r < C / 4; ++r)
+                    {
+                        __m128i index = _mm_loadu_si128(reinterpret_cast<const __m128i *>(columns.data() + k + 4 * r));
+                        __m256d x = _mm256_mask_i32gather_pd(_mm256_setzero_pd(), v, index, all_lanes, sizeof(double));
+                        sum[r] = _mm256_fmadd_pd(_mm256_loadu_pd(values.data() + k + 4 * r), x, sum[r]);
+                    }
+                }
+                alignas(32) double buffer[C];
+                for (std::size_t r = 0; r < C / 4; ++r)
+                {
+                    _mm256_store_pd(buffer + 4 * r, sum[r]);
+                }
+                for (std::size_t r = 0; r < C; ++r)
+                {
+                    result[permutation[s * C + r]] = buffer[r];
+                }
+            }
+        }
+        else
+        {
+            multiply_scalar(v, result, first, last);
+        }
+    }
+
+    template <typename T, std::size_t C>
+    __attribute__((target("avx512f"))) void SellMatrix<T, C>::multiply_avx512(const T *v, T *result, std::size_t first, std::size_t last) const
+    {
+        if constexpr (std::is_same_v<T, double>)
+        {
+            for (std::size_t s = first; s < last; ++s)
+            {
+                __m512d sum[C / 8];
+                for (auto &lane : sum)
+                {
+                    lane = _mm512_setzero_pd();
+                }
+                for (std::size_t k = slice_offsets[s]; k < slice_offsets[s + 1]; k += C)
+                {
+                    for (std::size_t r = 0; r < C / 8; ++r)
+                    {
+                        __m256i index = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(columns.data() + k + 8 * r));
+                        __m512d x = _mm512_mask_i32gather_pd(_mm512_setzero_pd(), 0xFF, index, v, sizeof(double));
+                        sum[r] = _mm512_fmadd_pd(_mm512_loadu_pd(values.data() + k + 8 * r), x, sum[r]);
+                    }
+                }
+                alignas(64) double buffer[C];
+                for (std::size_t r = 0; r < C / 8; ++r)
+                {
+                    _mm512_store_pd(buffer + 8 * r, sum[r]);
+                }
+                for (std::size_t r = 0; r < C; ++r)
+                {
+                    result[permutation[s * C + r]] = buffer[r];
+                }
+            }
+        }
+        else
+        {
+            multiply_scalar(v, result, first, last);
+        }
+    }
+#endif
+}
+
+#endif
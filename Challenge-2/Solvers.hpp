@@ -0,0 +1,432 @@
+#ifndef SOLVERS_HPP
+#define SOLVERS_HPP
+
+#include <chrono>
+#include <cmath>
+#include <span>
+#include <vector>
+#include "Matrix.hpp"
+#include "Preconditioners.hpp"
+
+namespace algebra
+{
+
+    /*!
+     * Settings of the iterative solvers
+     */
+    struct SolverOptions
+    {
+        std::size_t max_iterations = 1000;
+        double tolerance = 1e-8;     // on the residual norm relative to the norm of b
+        std::size_t restart = 30;    // Krylov subspace size of GMRES
+        bool record_history = false; // store the residual and the time of each iteration
+    };
+
+    /*!
+     * Outcome of an iterative solver. The histories are filled if SolverOptions::record_history is set:
+     * entry 0 refers to the initial guess, entry k to iteration k, times are in nanoseconds from the start
+     */
+    struct SolverResult
+    {
+        bool converged = false;
+        std::size_t iterations = 0;
+        double residual = 0; // relative residual norm
+        double time = 0;     // nanoseconds
+        std::vector<double> residual_history;
+        std::vector<double> time_history;
+    };
+
+    /*!
+     * Preconditioned conjugate gradient for symmetric positive definite matrices.
+     * The vectors are allocated once, the iterations do not allocate memory; p . A p comes from the fused multiply_dot()
+     * @param A Square compressed matrix
+     * @param b Right hand side
+     * @param x Initial guess, overwritten with the solution
+     * @param M Preconditioner, with a method apply(r, z) computing z = M^-1 r
+     * @param options Tolerance, maximum number of iterations and instrumentation
+     * @return std::runtime_error if the sizes do not match
+     */
+    template <typename T, StorageOrder Order, typename Index, typename Storage, typename Preconditioner = IdentityPreconditioner<T>>
+    SolverResult conjugate_gradient(const Matrix<T, Order, Index, Storage> &A, std::span<const T> b, std::span<T> x,
+                                    const Preconditioner &M = Preconditioner(), const SolverOptions &options = SolverOptions());
+
+    /*!
+     * Right preconditioned BiCGSTAB for general square matrices
+     * @param A Square compressed matrix
+     * @param b Right hand side
+     * @param x Initial guess, overwritten with the solution
+     * @param M Preconditioner, with a method apply(r, z) computing z = M^-1 r
+     * @param options Tolerance, maximum number of iterations and instrumentation
+     * @return std::runtime_error if the sizes do not match
+     */
+    template <typename T, StorageOrder Order, typename Index, typename Storage, typename Preconditioner = IdentityPreconditioner<T>>
+    SolverResult bicgstab(const Matrix<T, Order, Index, Storage> &A, std::span<const T> b, std::span<T> x,
+                          const Preconditioner &M = Preconditioner(), const SolverOptions &options = SolverOptions());
+
+    /*!
+     * Right preconditioned restarted GMRES(m), m = options.restart, with modified Gram-Schmidt and Givens rotations.
+     * An iteration is one Arnoldi step, the residual of the least squares problem is monitored at each step
+     * @param A Square compressed matrix
+     * @param b Right hand side
+     * @param x Initial guess, overwritten with the solution
+     * @param M Preconditioner, with a method apply(r, z) computing z = M^-1 r
+     * @param options Tolerance, maximum number of iterations, restart and instrumentation
+     * @return std::runtime_error if the sizes do not match
+     */
+    template <typename T, StorageOrder Order, typename Index, typename Storage, typename Preconditioner = IdentityPreconditioner<T>>
+    SolverResult gmres(const Matrix<T, Order, Index, Storage> &A, std::span<const T> b, std::span<T> x,
+                       const Preconditioner &M = Preconditioner(), const SolverOptions &options = SolverOptions());
+
+    namespace detail
+    {
+        template <typename T>
+        T dot(std::span<const T> a, std::span<const T> b)
+        {
+            T sum = 0;
+            for (std::size_t i = 0; i < a.size(); ++i)
+            {
+                sum += a[i] * b[i];
+            }
+            return sum;
+        }
+
+        template <typename T>
+        T norm(std::span<const T> a)
+        {
+            return std::sqrt(dot(a, a));
+        }
+
+        /*!
+         * Time and residual bookkeeping shared by the solvers, the histories are reserved once
+         */
+        class SolverMonitor
+        {
+        private:
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            const SolverOptions &options;
+            SolverResult &result;
+            double reference;
+
+        public:
+            SolverMonitor(const SolverOptions &solver_options, SolverResult &solver_result, double b_norm)
+                : options(solver_options), result(solver_result), reference(b_norm > 0 ? b_norm : 1)
+            {
+                if (options.record_history)
+                {
+                    result.residual_history.reserve(options.max_iterations + 1);
+                    result.time_history.reserve(options.max_iterations + 1);
+                }
+            }
+
+            /*!
+             * Record the residual norm after an iteration
+             * @return true if the tolerance is reached
+             */
+            bool record(double residual_norm)
+            {
+                result.residual = residual_norm / reference;
+                result.time = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+                if (options.record_history)
+                {
+                    result.residual_history.push_back(result.residual);
+                    result.time_history.push_back(result.time);
+                }
+                result.converged = result.residual <= options.tolerance;
+                return result.converged;
+            }
+        };
+    }
+
+    /*
+     * ***************************************************************************
+     * Definitions
+     * ***************************************************************************
+     */
+    template <typename T, StorageOrder Order, typename Index, typename Storage, typename Preconditioner>
+    SolverResult conjugate_gradient(const Matrix<T, Order, Index, Storage> &A, std::span<const T> b, std::span<T> x,
+                                    const Preconditioner &M, const SolverOptions &options)
+    {
+        const std::size_t n = A.get_rows();
+        if (A.get_columns() != n || b.size() != n || x.size() != n)
+        {
+            throw std::runtime_error("Non comforming sizes for the linear system");
+        }
+
+        SolverResult result;
+        std::vector<T> r(n), z(n), p(n), q(n);
+        detail::SolverMonitor monitor(options, result, detail::norm(b));
+
+        // r = b - A x
+        A.multiply(x, r);
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            r[i] = b[i] - r[i];
+        }
+        if (monitor.record(detail::norm<T>(r)))
+        {
+            return result;
+        }
+
+        M.apply(r, z);
+        std::copy(z.begin(), z.end(), p.begin());
+        T rz = detail::dot<T>(r, z);
+
+        while (result.iterations < options.max_iterations)
+        {
+            ++result.iterations;
+
+            // q = A p and p . q in a single pass
+            T alpha = rz / A.multiply_dot(p, q, p);
+            T r_norm = 0;
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                x[i] += alpha * p[i];
+                r[i] -= alpha * q[i];
+                r_norm += r[i] * r[i];
+            }
+            if (monitor.record(std::sqrt(r_norm)))
+            {
+                break;
+            }
+
+            M.apply(r, z);
+            T rz_new = detail::dot<T>(r, z);
+            T beta = rz_new / rz;
+            rz = rz_new;
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                p[i] = z[i] + beta * p[i];
+            }
+        }
+
+        return result;
+    }
+
+    template <typename T, StorageOrder Order, typename Index, typename Storage, typename Preconditioner>
+    SolverResult bicgstab(const Matrix<T, Order, Index, Storage> &A, std::span<const T> b, std::span<T> x,
+                          const Preconditioner &M, const SolverOptions &options)
+    {
+        const std::size_t n = A.get_rows();
+        if (A.get_columns() != n || b.size() != n || x.size() != n)
+        {
+            throw std::runtime_error("Non comforming sizes for the linear system");
+        }
+
+        SolverResult result;
+        std::vector<T> r(n), r_hat(n), p(n, 0), v(n, 0), p_hat(n), s_hat(n), t(n);
+        const double b_norm = detail::norm(b);
+        detail::SolverMonitor monitor(options, result, b_norm);
+
+        // r = b - A x, the shadow residual is the initial residual
+        A.multiply(x, r);
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            r[i] = b[i] - r[i];
+        }
+        std::copy(r.begin(), r.end(), r_hat.begin());
+        if (monitor.record(detail::norm<T>(r)))
+        {
+            return result;
+        }
+
+        T rho = 1, alpha = 1, omega = 1;
+        while (result.iterations < options.max_iterations)
+        {
+            ++result.iterations;
+
+            T rho_new = detail::dot<T>(r_hat, r);
+            if (rho_new == T(0))
+            {
+                break; // breakdown
+            }
+            T beta = (rho_new / rho) * (alpha / omega);
+            rho = rho_new;
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                p[i] = r[i] + beta * (p[i] - omega * v[i]);
+            }
+
+            // v = A M^-1 p and r_hat . v in a single pass
+            M.apply(p, p_hat);
+            alpha = rho / A.multiply_dot(p_hat, v, r_hat);
+
+            // s = r - alpha v is stored in r
+            T s_norm = 0;
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                r[i] -= alpha * v[i];
+                s_norm += r[i] * r[i];
+            }
+            if (std::sqrt(s_norm) <= options.tolerance * (b_norm > 0 ? b_norm : 1))
+            {
+                for (std::size_t i = 0; i < n; ++i)
+                {
+                    x[i] += alpha * p_hat[i];
+                }
+                monitor.record(std::sqrt(s_norm));
+                break;
+            }
+
+            // t = A M^-1 s and s . t in a single pass
+            M.apply(r, s_hat);
+            T ts = A.multiply_dot(s_hat, t, r);
+            T tt = detail::dot<T>(t, t);
+            omega = (tt != T(0)) ? ts / tt : T(0);
+
+            T r_norm = 0;
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                x[i] += alpha * p_hat[i] + omega * s_hat[i];
+                r[i] -= omega * t[i];
+                r_norm += r[i] * r[i];
+            }
+            if (monitor.record(std::sqrt(r_norm)) || omega == T(0))
+            {
+                break;
+            }
+        }
+
+        return result;
+    }
+
+    template <typename T, StorageOrder Order, typename Index, typename Storage, typename Preconditioner>
+    SolverResult gmres(const Matrix<T, Order, Index, Storage> &A, std::span<const T> b, std::span<T> x,
+                       const Preconditioner &M, const SolverOptions &options)
+    {
+        const std::size_t n = A.get_rows();
+        if (A.get_columns() != n || b.size() != n || x.size() != n)
+        {
+            throw std::runtime_error("Non comforming sizes for the linear system");
+        }
+
+        const std::size_t m = std::max<std::size_t>(1, options.restart);
+        SolverResult result;
+        std::vector<T> V((m + 1) * n); // Krylov basis, one vector after the other
+        std::vector<T> H((m + 1) * m); // Hessenberg matrix, column by column
+        std::vector<T> cs(m), sn(m), g(m + 1), y(m), w(n), z(n);
+        detail::SolverMonitor monitor(options, result, detail::norm(b));
+
+        auto basis = [&](std::size_t k)
+        { return std::span<T>(V.data() + k * n, n); };
+
+        bool first_cycle = true;
+        while (true)
+        {
+            // r = b - A x in the first basis vector
+            auto v0 = basis(0);
+            A.multiply(x, v0);
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                v0[i] = b[i] - v0[i];
+            }
+            T beta = detail::norm<T>(v0);
+            if (first_cycle && monitor.record(beta))
+            {
+                return result;
+            }
+            first_cycle = false;
+            if (beta == T(0) || result.iterations >= options.max_iterations)
+            {
+                break;
+            }
+            for (auto &entry : v0)
+            {
+                entry /= beta;
+            }
+            std::fill(g.begin(), g.end(), T(0));
+            g[0] = beta;
+
+            std::size_t k = 0;
+            bool done = false;
+            for (; k < m && result.iterations < options.max_iterations; ++k)
+            {
+                ++result.iterations;
+
+                // Arnoldi step, w = A M^-1 v_k orthogonalized with modified Gram-Schmidt
+                M.apply(basis(k), z);
+                A.multiply(z, w);
+                T *h = H.data() + k * (m + 1);
+                for (std::size_t j = 0; j <= k; ++j)
+                {
+                    auto vj = basis(j);
+                    h[j] = detail::dot<T>(w, vj);
+                    for (std::size_t i = 0; i < n; ++i)
+                    {
+                        w[i] -= h[j] * vj[i];
+                    }
+                }
+                h[k + 1] = detail::norm<T>(w);
+                if (h[k + 1] != T(0))
+                {
+                    auto next = basis(k + 1);
+                    for (std::size_t i = 0; i < n; ++i)
+                    {
+                        next[i] = w[i] / h[k + 1];
+                    }
+                }
+
+                // Previous rotations on the new column, then the rotation that zeroes h[k + 1]
+                for (std::size_t j = 0; j < k; ++j)
+                {
+                    T temp = cs[j] * h[j] + sn[j] * h[j + 1];
+                    h[j + 1] = -sn[j] * h[j] + cs[j] * h[j + 1];
+                    h[j] = temp;
+                }
+                T denominator = std::hypot(h[k], h[k + 1]);
+                if (denominator == T(0))
+                {
+                    // A M^-1 v_k is in the span of the previous vectors and H is singular, stop with them
+                    done = true;
+                    break;
+                }
+                cs[k] = h[k] / denominator;
+                sn[k] = h[k + 1] / denominator;
+                h[k] = denominator;
+                h[k + 1] = 0;
+                g[k + 1] = -sn[k] * g[k];
+                g[k] = cs[k] * g[k];
+
+                done = monitor.record(std::abs(g[k + 1])) || g[k + 1] == T(0);
+                if (done)
+                {
+                    ++k;
+                    break;
+                }
+            }
+
+            // x += M^-1 V y, with H y = g solved by back substitution
+            for (std::size_t i = k; i-- > 0;)
+            {
+                T sum = g[i];
+                for (std::size_t j = i + 1; j < k; ++j)
+                {
+                    sum -= H[j * (m + 1) + i] * y[j];
+                }
+                y[i] = sum / H[i * (m + 1) + i];
+            }
+            std::fill(w.begin(), w.end(), T(0));
+            for (std::size_t j = 0; j < k; ++j)
+            {
+                auto vj = basis(j);
+                for (std::size_t i = 0; i < n; ++i)
+                {
+                    w[i] += y[j] * vj[i];
+                }
+            }
+            M.apply(w, z);
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                x[i] += z[i];
+            }
+
+            if (done || result.iterations >= options.max_iterations)
+            {
+                break;
+            }
+        }
+
+        return result;
+    }
+}
+
+#endif
@@ -0,0 +1,446 @@
+#ifndef SPARSEOPERATIONS_HPP
+#define SPARSEOPERATIONS_HPP
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+#include "Matrix.hpp"
+#include "Parallel.hpp"
+
+namespace algebra
+{
+
+    /*!
+     * Transpose of a compressed matrix in the same storage order, with a counting sort in O(nnz)
+     * @param matrix Compressed matrix
+     * @return the compressed transpose, with the same number of threads
+     * @return std::runtime_error if the matrix is not compressed
+     */
+    template <typename T, StorageOrder Order, typename Index, typename Storage>
+    Matrix<T, Order, Index, Storage> transpose(const Matrix<T, Order, Index, Storage> &matrix);
+
+    /*!
+     * The same compressed matrix in another storage order (CSR to CSC or CSC to CSR), in O(nnz)
+     *   @tparam NewOrder storage order of the result
+     * @param matrix Compressed matrix
+     * @return std::runtime_error if the matrix is not compressed
+     */
+    template <StorageOrder NewOrder, typename T, StorageOrder Order, typename Index, typename Storage>
+    Matrix<T, NewOrder, Index, Storage> convert(const Matrix<T, Order, Index, Storage> &matrix);
+
+    /*!
+     * Sum of two compressed matrices of the same size, merging their rows (columns) in parallel
+     * @return the compressed matrix alpha * A + beta * B, elements present in A or B are stored even if they cancel
+     * @return std::runtime_error if the matrices are not compressed or have different sizes
+     */
+    template <typename T, StorageOrder Order, typename Index, typename Storage>
+    Matrix<T, Order, Index, Storage> add(const Matrix<T, Order, Index, Storage> &A, const Matrix<T, Order, Index, Storage> &B, T alpha = 1, T beta = 1);
+
+    /*!
+     * Sum of two compressed matrices
+     */
+    template <typename T, StorageOrder Order, typename Index, typename Storage>
+    Matrix<T, Order, Index, Storage> operator+(const Matrix<T, Order, Index, Storage> &A, const Matrix<T, Order, Index, Storage> &B)
+    {
+        return add(A, B);
+    }
+
+    /*!
+     * Sparse matrix-matrix product C = A * B with Gustavson's algorithm, row by row for ROWMAJOR and
+     * column by column for COLMAJOR, on the threads of A. The symbolic phase (constructor) computes the
+     * pattern of C, the numeric phase (compute) its values and can be repeated when only the values
+     * of A and B change. The numeric phase does not allocate when C already holds the product, and it
+     * must not be called concurrently on the same object
+     */
+    template <typename T, StorageOrder Order, typename Index, typename Storage>
+    class SparseProduct
+    {
+    private:
+        // Pattern of C
+        std::size_t n_rows = 0;
+        std::size_t n_columns = 0;
+        std::vector<Index> offsets;
+        std::vector<Index> indices;
+
+        // Rows (columns) of C of each thread, balanced by number of multiplications, and dense accumulators
+        std::size_t n_threads = 1;
+        std::vector<std::size_t> thread_bounds;
+        mutable std::vector<T> accumulators;
+
+        // A * B is computed as first * second on the compressed arrays: C = A * B in CSR, C^T = B^T * A^T in CSC
+        static const Matrix<T, Order, Index, Storage> &first(const Matrix<T, Order, Index, Storage> &A, const Matrix<T, Order, Index, Storage> &B)
+        {
+            return (Order == StorageOrder::ROWMAJOR) ? A : B;
+        }
+
+        static const Matrix<T, Order, Index, Storage> &second(const Matrix<T, Order, Index, Storage> &A, const Matrix<T, Order, Index, Storage> &B)
+        {
+            return (Order == StorageOrder::ROWMAJOR) ? B : A;
+        }
+
+        void check(const Matrix<T, Order, Index, Storage> &A, const Matrix<T, Order, Index, Storage> &B) const;
+
+    public:
+        /*!
+         * Symbolic phase, compute the pattern of A * B
+         * @param A Compressed matrix
+         * @param B Compressed matrix with as many rows as the columns of A
+         * @return std::runtime_error if the matrices are not compressed or their sizes do not match
+         */
+        SparseProduct(const Matrix<T, Order, Index, Storage> &A, const Matrix<T, Order, Index, Storage> &B);
+
+        /*!
+         * Get the number of non-zero elements of the product
+         */
+        std::size_t get_nnz() const
+        {
+            return indices.size();
+        }
+
+        /*!
+         * Numeric phase, compute A * B into C. A and B must have the patterns given to the constructor,
+         * if C does not have the pattern of the product yet it is replaced by a matrix with this pattern
+         * @param A Compressed matrix
+         * @param B Compressed matrix
+         * @param C Result
+         * @return std::runtime_error if the sizes of A and B differ from the ones of the symbolic phase
+         */
+        void compute(const Matrix<T, Order, Index, Storage> &A, const Matrix<T, Order, Index, Storage> &B, Matrix<T, Order, Index, Storage> &C) const;
+
+        /*!
+         * Numeric phase, compute A * B in a new matrix
+         */
+        Matrix<T, Order, Index, Storage> compute(const Matrix<T, Order, Index, Storage> &A, const Matrix<T, Order, Index, Storage> &B) const
+        {
+            Matrix<T, Order, Index, Storage> C(n_rows, n_columns);
+            compute(A, B, C);
+            return C;
+        }
+    };
+
+    /*!
+     * Sparse matrix-matrix product, symbolic and numeric phases together
+     * @return the compressed matrix A * B, with the threads of A
+     */
+    template <typename T, StorageOrder Order, typename Index, typename Storage>
+    Matrix<T, Order, Index, Storage> operator*(const Matrix<T, Order, Index, Storage> &A, const Matrix<T, Order, Index, Storage> &B)
+    {
+        return SparseProduct<T, Order, Index, Storage>(A, B).compute(A, B);
+    }
+
+    namespace detail
+    {
+        /*!
+         * Transpose compressed arrays with n_major rows and n_minor columns, the indices of the result are sorted
+         */
+        template <typename Index, typename Storage>
+        void transpose_arrays(std::size_t n_major, std::size_t n_minor,
+                              const std::vector<Index> &offsets, const std::vector<Index> &indices, const std::vector<Storage> &values,
+                              std::vector<Index> &t_offsets, std::vector<Index> &t_indices, std::vector<Storage> &t_values)
+        {
+            t_offsets.assign(n_minor + 1, 0);
+            for (auto index : indices)
+            {
+                t_offsets[index + 1]++;
+            }
+            for (std::size_t m = 0; m < n_minor; ++m)
+            {
+                t_offsets[m + 1] += t_offsets[m];
+            }
+
+            // Rows are visited in order, so the indices of each column of the result come out sorted
+            std::vector<Index> next(t_offsets.begin(), t_offsets.end() - 1);
+            t_indices.resize(indices.size());
+            t_values.resize(values.size());
+            for (std::size_t m = 0; m < n_major; ++m)
+            {
+                for (std::size_t k = offsets[m]; k < offsets[m + 1]; ++k)
+                {
+                    Index position = next[indices[k]]++;
+                    t_indices[position] = static_cast<Index>(m);
+                    t_values[position] = values[k];
+                }
+            }
+        }
+    }
+
+    /*
+     * ***************************************************************************
+     * Definitions
+     * ***************************************************************************
+     */
+    template <typename T, StorageOrder Order, typename Index, typename Storage>
+    Matrix<T, Order, Index, Storage> transpose(const Matrix<T, Order, Index, Storage> &matrix)
+    {
+        if (!matrix.is_compressed())
+        {
+            throw std::runtime_error("Only compressed matrices can be transposed");
+        }
+
+        const std::size_t n_major = (Order == StorageOrder::ROWMAJOR) ? matrix.get_rows() : matrix.get_columns();
+        const std::size_t n_minor = (Order == StorageOrder::ROWMAJOR) ? matrix.get_columns() : matrix.get_rows();
+        std::vector<Index> offsets, indices;
+        std::vector<Storage> values;
+        detail::transpose_arrays(n_major, n_minor, matrix.get_offsets(), matrix.get_indices(), matrix.get_values(), offsets, indices, values);
+
+        Matrix<T, Order, Index, Storage> result(matrix.get_columns(), matrix.get_rows());
+        result.set_threads(matrix.get_threads());
+        result.set_compressed(matrix.get_columns(), matrix.get_rows(), std::move(offsets), std::move(indices), std::move(values));
+        return result;
+    }
+
+    template <StorageOrder NewOrder, typename T, StorageOrder Order, typename Index, typename Storage>
+    Matrix<T, NewOrder, Index, Storage> convert(const Matrix<T, Order, Index, Storage> &matrix)
+    {
+        if (!matrix.is_compressed())
+        {
+            throw std::runtime_error("Only compressed matrices can be converted");
+        }
+
+        Matrix<T, NewOrder, Index, Storage> result(matrix.get_rows(), matrix.get_columns());
+        result.set_threads(matrix.get_threads());
+        if constexpr (NewOrder == Order)
+        {
+            result.set_compressed(matrix.get_rows(), matrix.get_columns(), matrix.get_offsets(), matrix.get_indices(), matrix.get_values());
+        }
+        else
+        {
+            // The CSC arrays of a matrix are the CSR arrays of its transpose
+            const std::size_t n_major = (Order == StorageOrder::ROWMAJOR) ? matrix.get_rows() : matrix.get_columns();
+            const std::size_t n_minor = (Order == StorageOrder::ROWMAJOR) ? matrix.get_columns() : matrix.get_rows();
+            std::vector<Index> offsets, indices;
+            std::vector<Storage> values;
+            detail::transpose_arrays(n_major, n_minor, matrix.get_offsets(), matrix.get_indices(), matrix.get_values(), offsets, indices, values);
+            result.set_compressed(matrix.get_rows(), matrix.get_columns(), std::move(offsets), std::move(indices), std::move(values));
+        }
+        return result;
+    }
+
+    template <typename T, StorageOrder Order, typename Index, typename Storage>
+    Matrix<T, Order, Index, Storage> add(const Matrix<T, Order, Index, Storage> &A, const Matrix<T, Order, Index, Storage> &B, T alpha, T beta)
+    {
+        if (!A.is_compressed() || !B.is_compressed())
+        {
+            throw std::runtime_error("Only compressed matrices can be added");
+        }
+        if (A.get_rows() != B.get_rows() || A.get_columns() != B.get_columns())
+        {
+            throw std::runtime_error("Non comforming sizes for the sum");
+        }
+
+        const auto &a_offsets = A.get_offsets();
+        const auto &a_indices = A.get_indices();
+        const auto &a_values = A.get_values();
+        const auto &b_offsets = B.get_offsets();
+        const auto &b_indices = B.get_indices();
+        const auto &b_values = B.get_values();
+        const std::size_t n_major = a_offsets.size() - 1;
+        const std::size_t n_threads = A.get_threads();
+        const std::vector<std::size_t> bounds = balanced_partition(a_offsets, n_threads);
+
+        // First pass: length of each merged row (column)
+        std::vector<Index> offsets(n_major + 1, 0);
+        parallel_for(n_threads, [&](std::size_t t)
+                     {
+            for (std::size_t m = bounds[t]; m < bounds[t + 1]; ++m)
+            {
+                std::size_t ka = a_offsets[m], kb = b_offsets[m], length = 0;
+                while (ka < a_offsets[m + 1] && kb < b_offsets[m + 1])
+                {
+                    Index a = a_indices[ka], b = b_indices[kb];
+                    ka += (a <= b);
+                    kb += (b <= a);
+                    ++length;
+                }
+                offsets[m + 1] = static_cast<Index>(length + (a_offsets[m + 1] - ka) + (b_offsets[m + 1] - kb));
+            } });
+
+        for (std::size_t m = 0; m < n_major; ++m)
+        {
+            if (static_cast<std::size_t>(offsets[m]) + offsets[m + 1] > std::numeric_limits<Index>::max())
+            {
+                throw std::overflow_error("Matrix too large for its index type, use a wider Index");
+            }
+            offsets[m + 1] += offsets[m];
+        }
+
+        // Second pass: merge
+        std::vector<Index> indices(offsets[n_major]);
+        std::vector<Storage> values(offsets[n_major]);
+        parallel_for(n_threads, [&](std::size_t t)
+                     {
+            for (std::size_t m = bounds[t]; m < bounds[t + 1]; ++m)
+            {
+                std::size_t ka = a_offsets[m], kb = b_offsets[m], k = offsets[m];
+                for (; ka < a_offsets[m + 1] || kb < b_offsets[m + 1]; ++k)
+                {
+                    bool from_a = ka < a_offsets[m + 1] && (kb == b_offsets[m + 1] || a_indices[ka] <= b_indices[kb]);
+                    bool from_b = kb < b_offsets[m + 1] && (ka == a_offsets[m + 1] || b_indices[kb] <= a_indices[ka]);
+                    T value = 0;
+                    if (from_a)
+                    {
+                        indices[k] = a_indices[ka];
+                        value += alpha * static_cast<T>(a_values[ka++]);
+                    }
+                    if (from_b)
+                    {
+                        indices[k] = b_indices[kb];
+                        value += beta * static_cast<T>(b_values[kb++]);
+                    }
+                    values[k] = static_cast<Storage>(value);
+                }
+            } });
+
+        Matrix<T, Order, Index, Storage> result(A.get_rows(), A.get_columns());
+        result.set_threads(n_threads);
+        result.set_compressed(A.get_rows(), A.get_columns(), std::move(offsets), std::move(indices), std::move(values));
+        return result;
+    }
+
+    template <typename T, StorageOrder Order, typename Index, typename Storage>
+    void SparseProduct<T, Order, Index, Storage>::check(const Matrix<T, Order, Index, Storage> &A, const Matrix<T, Order, Index, Storage> &B) const
+    {
+        if (!A.is_compressed() || !B.is_compressed())
+        {
+            throw std::runtime_error("Only compressed matrices can be multiplied");
+        }
+        if (A.get_columns() != B.get_rows())
+        {
+            throw std::runtime_error("Non comforming sizes for the product");
+        }
+    }
+
+    template <typename T, StorageOrder Order, typename Index, typename Storage>
+    SparseProduct<T, Order, Index, Storage>::SparseProduct(const Matrix<T, Order, Index, Storage> &A, const Matrix<T, Order, Index, Storage> &B)
+        : n_rows(A.get_rows()), n_columns(B.get_columns()), n_threads(A.get_threads())
+    {
+        check(A, B);
+
+        const auto &f_offsets = first(A, B).get_offsets();
+        const auto &f_indices = first(A, B).get_indices();
+        const auto &s_offsets = second(A, B).get_offsets();
+        const auto &s_indices = second(A, B).get_indices();
+        const std::size_t n_major = f_offsets.size() - 1;
+        const std::size_t n_minor = (Order == StorageOrder::ROWMAJOR) ? n_columns : n_rows;
+
+        // Balance the threads on the number of multiplications of each row (column)
+        std::vector<std::size_t> work(n_major + 1, 0);
+        for (std::size_t m = 0; m < n_major; ++m)
+        {
+            std::size_t products = 0;
+            for (std::size_t k = f_offsets[m]; k < f_offsets[m + 1]; ++k)
+            {
+                products += s_offsets[f_indices[k] + 1] - s_offsets[f_indices[k]];
+            }
+            work[m + 1] = work[m] + products;
+        }
+        thread_bounds = balanced_partition(work, n_threads);
+
+        // First pass: count the distinct indices of each row (column), marker[j] holds the last row that reached index j
+        constexpr std::size_t none = static_cast<std::size_t>(-1);
+        std::vector<std::size_t> markers(n_threads * n_minor, none);
+        std::vector<std::size_t> lengths(n_major + 1, 0);
+        parallel_for(n_threads, [&](std::size_t t)
+                     {
+            std::size_t *marker = markers.data() + t * n_minor;
+            for (std::size_t m = thread_bounds[t]; m < thread_bounds[t + 1]; ++m)
+            {
+                std::size_t length = 0;
+                for (std::size_t k = f_offsets[m]; k < f_offsets[m + 1]; ++k)
+                {
+                    for (std::size_t p = s_offsets[f_indices[k]]; p < s_offsets[f_indices[k] + 1]; ++p)
+                    {
+                        if (marker[s_indices[p]] != m)
+                        {
+                            marker[s_indices[p]] = m;
+                            ++length;
+                        }
+                    }
+                }
+                lengths[m + 1] = length;
+            } });
+
+        for (std::size_t m = 0; m < n_major; ++m)
+        {
+            lengths[m + 1] += lengths[m];
+        }
+        if (std::max(n_rows, n_columns) > std::numeric_limits<Index>::max() || lengths[n_major] > std::numeric_limits<Index>::max())
+        {
+            throw std::overflow_error("Matrix too large for its index type, use a wider Index");
+        }
+        offsets.assign(lengths.begin(), lengths.end());
+
+        // Second pass: collect and sort the indices
+        std::fill(markers.begin(), markers.end(), none);
+        indices.resize(lengths[n_major]);
+        parallel_for(n_threads, [&](std::size_t t)
+                     {
+            std::size_t *marker = markers.data() + t * n_minor;
+            for (std::size_t m = thread_bounds[t]; m < thread_bounds[t + 1]; ++m)
+            {
+                std::size_t position = lengths[m];
+                for (std::size_t k = f_offsets[m]; k < f_offsets[m + 1]; ++k)
+                {
+                    for (std::size_t p = s_offsets[f_indices[k]]; p < s_offsets[f_indices[k] + 1]; ++p)
+                    {
+                        if (marker[s_indices[p]] != m)
+                        {
+                            marker[s_indices[p]] = m;
+                            indices[position++] = s_indices[p];
+                        }
+                    }
+                }
+                std::sort(indices.begin() + lengths[m], indices.begin() + lengths[m + 1]);
+            } });
+
+        accumulators.assign(n_threads * n_minor, T(0));
+    }
+
+    template <typename T, StorageOrder Order, typename Index, typename Storage>
+    void SparseProduct<T, Order, Index, Storage>::compute(const Matrix<T, Order, Index, Storage> &A, const Matrix<T, Order, Index, Storage> &B, Matrix<T, Order, Index, Storage> &C) const
+    {
+        check(A, B);
+        if (A.get_rows() != n_rows || B.get_columns() != n_columns)
+        {
+            throw std::runtime_error("The matrices do not match the symbolic phase of the product");
+        }
+
+        if (!C.is_compressed() || C.get_rows() != n_rows || C.get_columns() != n_columns || C.get_offsets() != offsets || C.get_indices() != indices)
+        {
+            C.set_threads(n_threads);
+            C.set_compressed(n_rows, n_columns, offsets, indices, std::vector<Storage>(indices.size()));
+        }
+
+        const auto &f_offsets = first(A, B).get_offsets();
+        const auto &f_indices = first(A, B).get_indices();
+        const auto &f_values = first(A, B).get_values();
+        const auto &s_offsets = second(A, B).get_offsets();
+        const auto &s_indices = second(A, B).get_indices();
+        const auto &s_values = second(A, B).get_values();
+        const std::size_t n_minor = (Order == StorageOrder::ROWMAJOR) ? n_columns : n_rows;
+        std::span<Storage> values = C.get_mutable_values();
+
+        // Scatter the products of each row (column) in a dense accumulator, then gather it on the pattern
+        parallel_for(n_threads, [&](std::size_t t)
+                     {
+            T *accumulator = accumulators.data() + t * n_minor;
+            for (std::size_t m = thread_bounds[t]; m < thread_bounds[t + 1]; ++m)
+            {
+                for (std::size_t k = f_offsets[m]; k < f_offsets[m + 1]; ++k)
+                {
+                    const T f_value = static_cast<T>(f_values[k]);
+                    for (std::size_t p = s_offsets[f_indices[k]]; p < s_offsets[f_indices[k] + 1]; ++p)
+                    {
+                        accumulator[s_indices[p]] += f_value * static_cast<T>(s_values[p]);
+                    }
+                }
+                for (std::size_t k = offsets[m]; k < offsets[m + 1]; ++k)
+                {
+                    values[k] = static_cast<Storage>(accumulator[indices[k]]);
+                    accumulator[indices[k]] = 0;
+                }
+            } });
+    }
+}
+
+#endif
@@ -0,0 +1,364 @@
+#ifndef SYMMETRICMATRIX_HPP
+#define SYMMETRICMATRIX_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "Matrix.hpp"
+#include "MatrixIO.hpp"
+#include "Parallel.hpp"
+
+namespace algebra
+{
+
+    /*!
+     * Symmetric sparse matrix storing only the diagonal and the strictly lower triangle, in CSR format.
+     * The diagonal is kept apart, so that it is available without searching (e.g. for Jacobi-type smoothers),
+     * and the multiplication reads each off-diagonal element once for both triangles
+     *   @tparam T type of the element in the matrix
+     *   @tparam Index type of the offsets and indices of the lower triangle
+     *   @tparam Storage type of the stored values
+     */
+    template <typename T, typename Index = std::uint32_t, typename Storage = T>
+    class SymmetricMatrix
+    {
+    private:
+        std::size_t n = 0;
+        std::size_t n_threads = 1;
+        std::size_t n_diagonal = 0; // diagonal elements present in the pattern
+
+        std::vector<Storage> diagonal;
+        std::vector<Index> offsets; // strictly lower triangle, row by row
+        std::vector<Index> indices;
+        std::vector<Storage> values;
+
+        // Rows of each thread, balanced by number of elements, and per-thread partial results of the upper triangle
+        std::vector<std::size_t> thread_bounds;
+        mutable std::vector<T> workspace;
+
+        void setup_threads();
+
+    public:
+        /*!
+         * Empty matrix of size n x n
+         * @param size Number of rows and columns
+         */
+        explicit SymmetricMatrix(std::size_t size = 0)
+            : n{size}, diagonal(size, Storage(0)), offsets(size + 1, 0)
+        {
+            setup_threads();
+        }
+
+        /*!
+         * Build the symmetric storage from the diagonal and the lower triangle of a square compressed matrix,
+         * the upper triangle is not read
+         * @param matrix Square compressed matrix, its number of threads is kept
+         * @return std::runtime_error if the matrix is not compressed and square
+         */
+        template <StorageOrder Order>
+        explicit SymmetricMatrix(const Matrix<T, Order, Index, Storage> &matrix);
+
+        /*!
+         * Read a symmetric matrix in Matrix Market format without expanding it, the threads set by set_threads()
+         * parse the file. Elements of the upper triangle are moved to the lower one, repeated elements are summed
+         * @param file_path Path of the file
+         * @return std::runtime_error if the file cannot be read or is not declared symmetric
+         */
+        void read_from_file(const std::string &file_path);
+
+        /*!
+         * Get the number of rows
+         */
+        std::size_t get_rows() const
+        {
+            return n;
+        }
+
+        /*!
+         * Get the number of columns
+         */
+        std::size_t get_columns() const
+        {
+            return n;
+        }
+
+        /*!
+         * Get the number of non-zero elements of the full matrix, both triangles
+         */
+        std::size_t get_nnz() const
+        {
+            return n_diagonal + 2 * values.size();
+        }
+
+        /*!
+         * Get the number of stored elements, diagonal and lower triangle
+         */
+        std::size_t get_stored() const
+        {
+            return n + values.size();
+        }
+
+        /*!
+         * Get the diagonal of the matrix
+         */
+        const std::vector<Storage> &get_diagonal() const
+        {
+            return diagonal;
+        }
+
+        /*!
+         * Get the offsets of the rows of the strictly lower triangle
+         */
+        const std::vector<Index> &get_offsets() const
+        {
+            return offsets;
+        }
+
+        /*!
+         * Get the column indices of the strictly lower triangle
+         */
+        const std::vector<Index> &get_indices() const
+        {
+            return indices;
+        }
+
+        /*!
+         * Get the values of the strictly lower triangle
+         */
+        const std::vector<Storage> &get_values() const
+        {
+            return values;
+        }
+
+        /*!
+         * Const call operator, elements of the upper triangle are read from the lower one
+         * @param i Row index
+         * @param j Column index
+         * @return std::out_of_range if indexes are out of range
+         */
+        T operator()(std::size_t i, std::size_t j) const;
+
+        /*!
+         * Set the number of threads used by the multiplication
+         * @param nthreads Number of threads, 0 selects the hardware concurrency
+         */
+        void set_threads(std::size_t nthreads)
+        {
+            n_threads = nthreads > 0 ? nthreads : std::max(1u, std::thread::hardware_concurrency());
+            setup_threads();
+        }
+
+        /*!
+         * Get the number of threads used by the multiplication
+         */
+        std::size_t get_threads() const
+        {
+            return n_threads;
+        }
+
+        /*!
+         * In-place matrix-vector multiplication y = alpha * A * x + beta * y in a single pass over the lower triangle:
+         * each element multiplies x in its row (lower triangle) and in its column (upper triangle).
+         * It does not allocate memory and must not be called concurrently on the same matrix when threaded
+         * @param x input vector of size n
+         * @param y output vector of size n
+         * @param alpha scaling of the product
+         * @param beta scaling of y
+         * @return std::runtime_error if the sizes do not match
+         */
+        void multiply(std::span<const T> x, std::span<T> y, T alpha = 1, T beta = 0) const;
+
+        /*!
+         * Matrix-vector multiplication operatoration
+         * @param v vector to permform the matrix-vector moltiplication
+         * @return a vector containing the result of the operation
+         */
+        std::vector<T> operator*(const std::vector<T> &v) const
+        {
+            std::vector<T> result(n);
+            multiply(v, result);
+            return result;
+        }
+    };
+
+    /*
+     * ***************************************************************************
+     * Definitions
+     * ***************************************************************************
+     */
+    template <typename T, typename Index, typename Storage>
+    template <StorageOrder Order>
+    SymmetricMatrix<T, Index, Storage>::SymmetricMatrix(const Matrix<T, Order, Index, Storage> &matrix)
+        : n{matrix.get_rows()}, n_threads{matrix.get_threads()}
+    {
+        if (!matrix.is_compressed() || matrix.get_rows() != matrix.get_columns())
+        {
+            throw std::runtime_error("Only square compressed matrices can be stored as symmetric");
+        }
+
+        const auto &matrix_offsets = matrix.get_offsets();
+        const auto &matrix_indices = matrix.get_indices();
+        const auto &matrix_values = matrix.get_values();
+        auto row = [](std::size_t major, std::size_t minor)
+        { return (Order == StorageOrder::ROWMAJOR) ? major : minor; };
+        auto column = [](std::size_t major, std::size_t minor)
+        { return (Order == StorageOrder::ROWMAJOR) ? minor : major; };
+
+        // Count the lower elements of each row; visiting rows (columns) in order keeps the columns of each row sorted
+        diagonal.assign(n, Storage(0));
+        offsets.assign(n + 1, 0);
+        for (std::size_t m = 0; m < n; ++m)
+        {
+            for (std::size_t k = matrix_offsets[m]; k < matrix_offsets[m + 1]; ++k)
+            {
+                std::size_t i = row(m, matrix_indices[k]), j = column(m, matrix_indices[k]);
+                if (i > j)
+                {
+                    offsets[i + 1]++;
+                }
+                else if (i == j)
+                {
+                    diagonal[i] = matrix_values[k];
+                    n_diagonal++;
+                }
+            }
+        }
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            offsets[i + 1] += offsets[i];
+        }
+
+        std::vector<Index> next(offsets.begin(), offsets.end() - 1);
+        indices.resize(offsets[n]);
+        values.resize(offsets[n]);
+        for (std::size_t m = 0; m < n; ++m)
+        {
+            for (std::size_t k = matrix_offsets[m]; k < matrix_offsets[m + 1]; ++k)
+            {
+                std::size_t i = row(m, matrix_indices[k]), j = column(m, matrix_indices[k]);
+                if (i > j)
+                {
+                    indices[next[i]] = static_cast<Index>(j);
+                    values[next[i]++] = matrix_values[k];
+                }
+            }
+        }
+
+        setup_threads();
+    }
+
+    template <typename T, typename Index, typename Storage>
+    void SymmetricMatrix<T, Index, Storage>::read_from_file(const std::string &file_path)
+    {
+        MatrixMarketHeader header;
+        std::vector<Triplet<T>> entries = read_matrix_market<T>(file_path, n_threads, header, false);
+        if (header.symmetry != "symmetric" || header.n_rows != header.n_columns)
+        {
+            throw std::runtime_error("Matrix Market file " + file_path + " is not declared symmetric");
+        }
+
+        // The lower triangle is assembled as a row-major matrix, whose parallel compress sorts and sums the entries
+        Matrix<T, StorageOrder::ROWMAJOR, Index, Storage> lower(header.n_rows, header.n_columns);
+        lower.set_threads(n_threads);
+        lower.reserve(entries.size());
+        for (const auto &t : entries)
+        {
+            lower.add(std::max(t.row, t.column), std::min(t.row, t.column), t.value);
+        }
+        std::vector<Triplet<T>>().swap(entries);
+        lower.compress();
+
+        *this = SymmetricMatrix(lower);
+    }
+
+    template <typename T, typename Index, typename Storage>
+    T SymmetricMatrix<T, Index, Storage>::operator()(std::size_t i, std::size_t j) const
+    {
+        if (i >= n || j >= n)
+        {
+            throw std::out_of_range("Index out of range");
+        }
+        if (i == j)
+        {
+            return static_cast<T>(diagonal[i]);
+        }
+        if (i < j)
+        {
+            std::swap(i, j);
+        }
+        auto first = indices.begin() + offsets[i];
+        auto last = indices.begin() + offsets[i + 1];
+        auto it = std::lower_bound(first, last, j);
+        return (it != last && *it == j) ? static_cast<T>(values[it - indices.begin()]) : T(0);
+    }
+
+    template <typename T, typename Index, typename Storage>
+    void SymmetricMatrix<T, Index, Storage>::setup_threads()
+    {
+        thread_bounds = balanced_partition(offsets, n_threads);
+
+        // Thread t scatters the upper triangle into the rows before its own block
+        workspace.assign(n_threads > 1 ? n_threads * n : 0, T(0));
+    }
+
+    template <typename T, typename Index, typename Storage>
+    void SymmetricMatrix<T, Index, Storage>::multiply(std::span<const T> x, std::span<T> y, T alpha, T beta) const
+    {
+        if (x.size() != n || y.size() != n)
+        {
+            throw std::runtime_error("Non comforming size for the input vector");
+        }
+
+        // Row i receives the lower triangle of its row and the upper triangle from the rows after it: rows before
+        // the block of the thread are written in its own part of the workspace, the others directly in y
+        parallel_for(n_threads, [&](std::size_t t)
+                     {
+            const std::size_t first = thread_bounds[t];
+            T *local = (t > 0) ? workspace.data() + t * n : nullptr;
+            if (local)
+            {
+                std::fill(local, local + first, T(0));
+            }
+
+            for (std::size_t i = first; i < thread_bounds[t + 1]; ++i)
+            {
+                const T scaled = alpha * x[i];
+                T sum = static_cast<T>(diagonal[i]) * x[i];
+                // Columns are sorted, so the ones before the block of the thread come first
+                std::size_t k = offsets[i];
+                for (; k < offsets[i + 1] && indices[k] < first; ++k)
+                {
+                    const T value = static_cast<T>(values[k]);
+                    sum += value * x[indices[k]];
+                    local[indices[k]] += value * scaled;
+                }
+                for (; k < offsets[i + 1]; ++k)
+                {
+                    const T value = static_cast<T>(values[k]);
+                    sum += value * x[indices[k]];
+                    y[indices[k]] += value * scaled;
+                }
+                // Row i is first written here, the rows after it only add to it
+                y[i] = (beta == T(0)) ? alpha * sum : alpha * sum + beta * y[i];
+            } });
+
+        // The contributions to the rows of the previous blocks are added in thread order
+        if (n_threads > 1)
+        {
+            parallel_for(n_threads, [&](std::size_t t)
+                         {
+                for (std::size_t i = thread_bounds[t]; i < thread_bounds[t + 1]; ++i)
+                {
+                    for (std::size_t p = t + 1; p < n_threads; ++p)
+                    {
+                        y[i] += workspace[p * n + i];
+                    }
+                } });
+        }
+    }
+}
+
+#endif
@@ -1,34 +1,990 @@
+#include <cmath>
 #include <chrono>
 #include <iostream>
+#include <thread>
+#include <random>
+#include <cstdio>
+#include <filesystem>
+#include <limits>
+#include <stdexcept>
+#include <string>
 #include "Matrix.hpp"
+#include "Benchmark.hpp"
+#include "SellMatrix.hpp"
+#include "MemoryTracker.hpp"
+#include "Solvers.hpp"
+#include "SparseOperations.hpp"
+#include "SymmetricMatrix.hpp"
 
 namespace algebra
 {
 
+    /*!
+     * Stop the tests with std::runtime_error if a check fails
+     * @param condition Result of the check
+     * @param message Description of the check
+     */
+    inline void check(bool condition, const std::string &message)
+    {
+        if (!condition)
+        {
+            throw std::runtime_error("Check failed: " + message);
+        }
+    }
+
+    /*!
+     * Largest absolute difference between two vectors of the same size
+     */
+    template <typename T>
+    T max_difference(const std::vector<T> &a, const std::vector<T> &b)
+    {
+        check(a.size() == b.size(), "vectors of the same size");
+        T difference = 0;
+        for (std::size_t i = 0; i < a.size(); ++i)
+        {
+            difference = std::max<T>(difference, std::abs(a[i] - b[i]));
+        }
+        return difference;
+    }
+
+    /*!
+     * True if two compressed matrices have the same size, pattern and values
+     */
+    template <typename T, StorageOrder Order, typename Index, typename Storage>
+    bool same_compressed(const Matrix<T, Order, Index, Storage> &a, const Matrix<T, Order, Index, Storage> &b)
+    {
+        return a.get_rows() == b.get_rows() && a.get_columns() == b.get_columns() &&
+               a.get_offsets() == b.get_offsets() && a.get_indices() == b.get_indices() && a.get_values() == b.get_values();
+    }
+
+    /*!
+     * Build a square banded matrix with 2 * half_band + 1 non-zero diagonals
+     * @param n Number of rows and columns
+     * @param half_band Number of diagonals above (and below) the main diagonal
+     */
+    template <StorageOrder Order, typename Index = std::uint32_t, typename Storage = double>
+    Matrix<double, Order, Index, Storage> banded_matrix(std::size_t n, std::size_t half_band)
+    {
+        Matrix<double, Order, Index, Storage> matrix(n, n);
+
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            std::size_t j_start = i > half_band ? i - half_band : 0;
+            std::size_t j_end = std::min(n, i + half_band + 1);
+            for (std::size_t j = j_start; j < j_end; ++j)
+            {
+                matrix.add(i, j, (i == j) ? 2.0 * half_band + 1 : -1.0 / (1.0 + i + j));
+            }
+        }
+
+        return matrix;
+    }
+
+    /*!
+     * Time the compressed matrix-vector multiplication with 1 up to max_threads threads
+     * and report the speedup against the serial loop
+     * @param test_matrix Compressed matrix to time
+     * @param max_threads Maximum number of threads
+     * @param N Number of multiplications for each thread count
+     */
     template <typename T, StorageOrder Order>
-    double timing_matrix(Matrix<T, Order> test_matrix)
+    void timing_threads(Matrix<T, Order> &test_matrix, std::size_t max_threads, std::size_t N = 20)
+    {
+        std::vector<T> unary_vector(test_matrix.get_columns(), 1);
+        std::size_t old_threads = test_matrix.get_threads();
+
+        double serial_time = 0;
+        for (std::size_t n_threads = 1; n_threads <= max_threads; ++n_threads)
+        {
+            test_matrix.set_threads(n_threads);
+            std::vector<T> reference = test_matrix * unary_vector;
+            bool reproducible = true;
+
+            auto start = std::chrono::high_resolution_clock::now();
+
+            for (std::size_t i = 0; i < N; i++)
+            {
+                std::vector<T> result = test_matrix * unary_vector;
+                reproducible = reproducible && (result == reference);
+            }
+
+            auto end = std::chrono::high_resolution_clock::now();
+            double duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / double(N);
+
+            if (n_threads == 1)
+            {
+                serial_time = duration;
+            }
+
+            std::cout << "Threads: " << n_threads
+                      << " - average execution time: " << duration << " nanoseconds"
+                      << " - speedup: " << serial_time / duration
+                      << " - reproducible: " << (reproducible ? "yes" : "no") << std::endl;
+        }
+
+        test_matrix.set_threads(old_threads);
+    }
+
+    /*!
+     * Check that an exception thrown by any call of parallel_for reaches the caller, and that parallel loops
+     * nested in the call of the calling thread or of a worker run serially instead of deadlocking
+     * @param test_matrix Compressed matrix, multiplied inside the parallel loop
+     */
+    template <typename T, StorageOrder Order, typename Index, typename Storage>
+    void test_parallel(const Matrix<T, Order, Index, Storage> &test_matrix)
+    {
+        for (std::size_t thrower : {0, 1, 2})
+        {
+            bool thrown = false;
+            try
+            {
+                parallel_for(3, [thrower](std::size_t t)
+                             { if (t == thrower) throw std::runtime_error("thread " + std::to_string(t)); });
+            }
+            catch (const std::runtime_error &e)
+            {
+                thrown = (e.what() == "thread " + std::to_string(thrower));
+            }
+            check(thrown, "exception thrown by call " + std::to_string(thrower) + " of parallel_for");
+        }
+
+        // Each call multiplies its own copy of the matrix, which runs its own parallel loop
+        std::vector<Matrix<T, Order, Index, Storage>> copies(2, test_matrix);
+        std::vector<T> x(test_matrix.get_columns(), 1);
+        std::vector<std::vector<T>> results(2, std::vector<T>(test_matrix.get_rows()));
+        for (auto &copy : copies)
+        {
+            copy.set_threads(2);
+        }
+        // The scattering product sums in thread order, the reference uses the same number of threads
+        const std::vector<T> reference = copies[0] * x;
+        parallel_for(2, [&](std::size_t t)
+                     { copies[t].multiply(x, results[t]); });
+        check(results[0] == reference && results[1] == reference, "parallel products nested in parallel_for");
+        std::cout << "Parallel loops: exceptions and nested loops checked" << std::endl;
+    }
+
+    /*!
+     * Generate n_entries random entries, with repetitions, clustered around the diagonal as in a finite element assembly
+     * @param n Number of rows and columns
+     * @param half_band Maximum distance of an entry from the diagonal
+     * @param n_entries Number of entries
+     */
+    inline std::vector<Triplet<double>> random_entries(std::size_t n, std::size_t half_band, std::size_t n_entries)
     {
-        size_t N = 100;
-        std::vector<double> unary_vector(131, 1);
+        std::mt19937_64 generator(42);
+        std::uniform_int_distribution<std::size_t> row(0, n - 1);
+        std::uniform_int_distribution<std::size_t> shift(0, 2 * half_band);
+        std::uniform_real_distribution<double> value(-1.0, 1.0);
+
+        std::vector<Triplet<double>> entries(n_entries);
+        for (auto &t : entries)
+        {
+            t.row = row(generator);
+            std::size_t column = t.row + shift(generator);
+            t.column = std::min(n - 1, column > half_band ? column - half_band : 0);
+            t.value = value(generator);
+        }
+
+        return entries;
+    }
+
+    /*!
+     * Compare time and peak heap memory of assembling and compressing a matrix
+     * through the map (operator()) and through the coordinate list (add())
+     * @param entries Entries of the matrix, repeated entries are summed
+     * @param n Number of rows and columns
+     */
+    template <StorageOrder Order>
+    void timing_assembly(const std::vector<Triplet<double>> &entries, std::size_t n)
+    {
+        for (bool use_map : {true, false})
+        {
+            std::size_t base = memory::current();
+            memory::reset_peak();
+
+            auto start = std::chrono::high_resolution_clock::now();
+
+            Matrix<double, Order> matrix(n, n);
+            if (use_map)
+            {
+                for (const auto &t : entries)
+                {
+                    matrix(t.row, t.column) += t.value;
+                }
+            }
+            else
+            {
+                matrix.reserve(entries.size());
+                for (const auto &t : entries)
+                {
+                    matrix.add(t.row, t.column, t.value);
+                }
+            }
+
+            auto assembled = std::chrono::high_resolution_clock::now();
+            matrix.compress();
+            auto end = std::chrono::high_resolution_clock::now();
+
+            auto assembly_time = std::chrono::duration_cast<std::chrono::milliseconds>(assembled - start);
+            auto compress_time = std::chrono::duration_cast<std::chrono::milliseconds>(end - assembled);
+
+            std::cout << (use_map ? "Map assembly: " : "Coordinate list assembly: ")
+                      << assembly_time.count() << " ms assembly, "
+                      << compress_time.count() << " ms compress, "
+                      << (memory::peak() - base) / (1024 * 1024) << " MiB peak memory" << std::endl;
+        }
+    }
+
+    /*!
+     * Time the access to the elements of a compressed matrix: random accesses and a sweep of every element row by row,
+     * with and without the cursor on the last accessed element
+     * @param test_matrix Compressed matrix to time
+     * @param n_accesses Number of random accesses
+     */
+    template <typename T, StorageOrder Order>
+    void timing_access(Matrix<T, Order> &test_matrix, std::size_t n_accesses)
+    {
+        const std::size_t n_rows = test_matrix.get_rows();
+        const std::size_t n_columns = test_matrix.get_columns();
+        const auto &const_matrix = test_matrix;
+
+        std::mt19937_64 generator(42);
+        std::uniform_int_distribution<std::size_t> row(0, n_rows - 1);
+        std::uniform_int_distribution<std::size_t> column(0, n_columns - 1);
+        std::vector<std::array<std::size_t, 2>> positions(n_accesses);
+        for (auto &position : positions)
+        {
+            position = {row(generator), column(generator)};
+        }
+
+        for (bool cursor : {false, true})
+        {
+            test_matrix.set_cursor(cursor);
+            T checksum = 0;
+
+            auto start = std::chrono::high_resolution_clock::now();
+            for (const auto &position : positions)
+            {
+                checksum += const_matrix(position[0], position[1]);
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+            double random_time = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / double(n_accesses);
+
+            // Sweep along the storage order, so that consecutive accesses fall in the same row (column)
+            start = std::chrono::high_resolution_clock::now();
+            for (std::size_t a = 0; a < (Order == StorageOrder::ROWMAJOR ? n_rows : n_columns); ++a)
+            {
+                for (std::size_t b = 0; b < (Order == StorageOrder::ROWMAJOR ? n_columns : n_rows); ++b)
+                {
+                    checksum += (Order == StorageOrder::ROWMAJOR) ? const_matrix(a, b) : const_matrix(b, a);
+                }
+            }
+            end = std::chrono::high_resolution_clock::now();
+            double sweep_time = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / double(n_rows * n_columns);
+
+            std::cout << "Cursor " << (cursor ? "on: " : "off: ")
+                      << random_time << " nanoseconds per random access, "
+                      << sweep_time << " nanoseconds per access in a sweep"
+                      << " (checksum " << checksum << ")" << std::endl;
+        }
+
+        test_matrix.set_cursor(false);
+    }
+
+    /*!
+     * Reference reader parsing the file one value at a time with operator>> and inserting the elements in the map
+     * @param matrix Matrix to fill
+     * @param file_path Path of a Matrix Market file in general coordinate format
+     */
+    template <typename T, StorageOrder Order>
+    void legacy_read_from_file(Matrix<T, Order> &matrix, const std::string &file_path)
+    {
+        std::fstream myfile(file_path);
+        std::size_t i, j, n_rows, n_columns, n_lines;
+        double value;
+
+        // Ignore comments headers
+        while (myfile.peek() == '%')
+        {
+            myfile.ignore(2048, '\n');
+        }
+
+        myfile >> n_rows >> n_columns >> n_lines;
+        matrix.resize(n_rows, n_columns);
+
+        for (std::size_t l = 0; l < n_lines; l++)
+        {
+            myfile >> i >> j >> value;
+            matrix(i - 1, j - 1) = value;
+        }
+    }
+
+    /*!
+     * Write a banded matrix with random values in Matrix Market format, then time the reference reader,
+     * the memory mapped parallel reader and the binary format, each followed by compress()
+     * @param n Number of rows and columns
+     * @param half_band Number of diagonals above (and below) the main diagonal
+     */
+    template <StorageOrder Order>
+    void timing_reading(std::size_t n, std::size_t half_band)
+    {
+        const std::string mtx_path = (std::filesystem::temp_directory_path() / "pacs_banded.mtx").string();
+        const std::string bin_path = (std::filesystem::temp_directory_path() / "pacs_banded.bin").string();
+
+        {
+            std::mt19937_64 generator(42);
+            std::uniform_real_distribution<double> value(-1.0, 1.0);
+            std::ofstream myfile(mtx_path);
+            myfile.precision(17);
+            myfile << "%%MatrixMarket matrix coordinate real general\n";
+            myfile << n << " " << n << " " << n * (2 * half_band + 1) - half_band * (half_band + 1) << "\n";
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                for (std::size_t j = (i > half_band ? i - half_band : 0); j < std::min(n, i + half_band + 1); ++j)
+                {
+                    myfile << i + 1 << " " << j + 1 << " " << value(generator) << "\n";
+                }
+            }
+        }
+        std::cout << "File size: " << std::filesystem::file_size(mtx_path) / (1024 * 1024) << " MiB" << std::endl;
+
+        auto time = [](auto &&f)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            f();
+            auto end = std::chrono::high_resolution_clock::now();
+            return std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+        };
+
+        Matrix<double, Order> legacy(1, 1);
+        std::cout << "operator>> reader: " << time([&]()
+                                               { legacy_read_from_file(legacy, mtx_path); legacy.compress(); })
+                  << " ms" << std::endl;
+
+        Matrix<double, Order> mapped(1, 1);
+        mapped.set_threads(0);
+        std::cout << "Memory mapped reader (" << mapped.get_threads() << " threads): " << time([&]()
+                                                                                            { mapped.read_from_file(mtx_path); mapped.compress(); })
+                  << " ms" << std::endl;
+
+        mapped.save_binary(bin_path);
+        Matrix<double, Order> binary(1, 1);
+        std::cout << "Binary reader: " << time([&]()
+                                               { binary.read_binary(bin_path); })
+                  << " ms" << std::endl;
+
+        // Both parsers read the same digits, so the matrices must be identical
+        check(same_compressed(mapped, legacy), "memory mapped reader against operator>> reader");
+        check(same_compressed(binary, legacy), "binary reader against operator>> reader");
+        Matrix<double, Order> chunked(1, 1);
+        chunked.set_threads(4);
+        chunked.read_from_file(mtx_path);
+        chunked.compress();
+        check(same_compressed(chunked, legacy), "memory mapped reader on 4 threads against operator>> reader");
+        std::cout << "Readers agree" << std::endl;
+
+        std::remove(mtx_path.c_str());
+        std::remove(bin_path.c_str());
+    }
+
+    /*!
+     * Time the multiplication of a compressed row-major matrix and of its SELL-C-sigma conversion
+     * with every kernel supported by the cpu
+     * @param test_matrix Compressed row-major matrix
+     * @param N Number of multiplications
+     */
+    template <typename T>
+    void timing_sell(const Matrix<T, StorageOrder::ROWMAJOR> &test_matrix, std::size_t N = 50)
+    {
+        std::vector<T> unary_vector(test_matrix.get_columns(), 1);
+
+        auto time = [&](auto &&multiply)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            for (std::size_t i = 0; i < N; i++)
+            {
+                std::vector<T> result = multiply(unary_vector);
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / double(N);
+        };
+
+        double csr_time = time([&](const std::vector<T> &v)
+                               { return test_matrix * v; });
+        std::cout << "CSR: " << csr_time << " nanoseconds" << std::endl;
+
+        SellMatrix<T> sell(test_matrix);
+
+        // Reference product on a vector with different entries, the kernels only change the order of the sums
+        std::vector<T> x(test_matrix.get_columns());
+        for (std::size_t j = 0; j < x.size(); ++j)
+        {
+            x[j] = T(1) + T(j % 7) / 8;
+        }
+        const std::vector<T> reference = test_matrix * x;
+        T tolerance = 0;
+        for (const auto &value : reference)
+        {
+            tolerance = std::max<T>(tolerance, std::abs(value));
+        }
+        tolerance *= 1e3 * std::numeric_limits<T>::epsilon();
+
+        std::cout << "SELL-8-256 padding: " << double(sell.get_stored()) / test_matrix.get_nnz() << " stored elements per non-zero" << std::endl;
+
+        for (auto kernel : {SellKernel::SCALAR, SellKernel::AVX2, SellKernel::AVX512})
+        {
+            if (!SellMatrix<T>::supports(kernel))
+            {
+                continue;
+            }
+            sell.set_kernel(kernel);
+            check(max_difference(sell * x, reference) <= tolerance, "SELL-C-sigma product against CSR product");
+            double sell_time = time([&](const std::vector<T> &v)
+                                    { return sell * v; });
+            std::cout << (kernel == SellKernel::SCALAR ? "SELL scalar: " : kernel == SellKernel::AVX2 ? "SELL AVX2: "
+                                                                                                   : "SELL AVX-512: ")
+                      << sell_time << " nanoseconds - speedup: " << csr_time / sell_time << std::endl;
+        }
+
+        // Slices split among threads
+        sell.set_threads(3);
+        check(max_difference(sell * x, reference) <= tolerance, "SELL-C-sigma product on 3 threads against CSR product");
+        sell.set_threads(1);
+    }
+
+    /*!
+     * Time the compressed matrix-vector multiplication and report the bytes per non-zero of the compressed storage
+     * and the effective bandwidth, counting one read of the compressed arrays and of the vector and one write of the result
+     * @param test_matrix Compressed matrix to time
+     * @param N Number of multiplications
+     */
+    template <typename T, StorageOrder Order, typename Index, typename Storage>
+    void timing_bandwidth(const Matrix<T, Order, Index, Storage> &test_matrix, std::size_t N = 50)
+    {
+        std::vector<T> unary_vector(test_matrix.get_columns(), 1);
 
-        // Start measuring time
         auto start = std::chrono::high_resolution_clock::now();
+        for (std::size_t i = 0; i < N; i++)
+        {
+            std::vector<T> result = test_matrix * unary_vector;
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        double duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / double(N);
+
+        const std::size_t nnz = test_matrix.get_nnz();
+        const double matrix_bytes = nnz * (sizeof(Index) + sizeof(Storage)) + test_matrix.get_offsets().size() * sizeof(Index);
+        const double vector_bytes = (test_matrix.get_rows() + test_matrix.get_columns()) * sizeof(T);
 
-        // Block of code to measure    
-        for (size_t i = 0; i < N; i++)
+        std::cout << "Index " << sizeof(Index) << " bytes, value " << sizeof(Storage) << " bytes: "
+                  << matrix_bytes / nnz << " bytes per non-zero, "
+                  << duration << " nanoseconds, "
+                  << (matrix_bytes + vector_bytes) / duration << " GB/s" << std::endl;
+    }
+
+    /*!
+     * Time the matrix-block multiplication for growing numbers of vectors, in both block orders,
+     * and report the cost per vector against the matrix-vector multiplication
+     * @param test_matrix Compressed matrix to time
+     * @param max_vectors Largest number of vectors, the number of vectors is doubled from 1
+     * @param N Number of multiplications for each number of vectors
+     */
+    template <typename T, StorageOrder Order, typename Index, typename Storage>
+    void timing_block(const Matrix<T, Order, Index, Storage> &test_matrix, std::size_t max_vectors, std::size_t N = 10)
+    {
+        auto time = [N](auto &&multiply)
         {
-            std::vector<double> result = test_matrix.operator*(unary_vector);
+            auto start = std::chrono::high_resolution_clock::now();
+            for (std::size_t i = 0; i < N; i++)
+            {
+                std::vector<T> result = multiply();
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / double(N);
+        };
+
+        std::vector<T> unary_vector(test_matrix.get_columns(), 1);
+        double vector_time = time([&]()
+                                  { return test_matrix * unary_vector; });
+        std::cout << "Matrix-vector: " << vector_time << " nanoseconds" << std::endl;
+
+        for (std::size_t n_vectors = 1; n_vectors <= max_vectors; n_vectors *= 2)
+        {
+            std::vector<T> block(test_matrix.get_columns() * n_vectors, 1);
+            double row_time = time([&]()
+                                   { return test_matrix.template multiply_block<StorageOrder::ROWMAJOR>(block, n_vectors); });
+            double col_time = time([&]()
+                                   { return test_matrix.template multiply_block<StorageOrder::COLMAJOR>(block, n_vectors); });
+
+            std::cout << n_vectors << " vectors - per vector: "
+                      << row_time / n_vectors << " nanoseconds (Row-major block), "
+                      << col_time / n_vectors << " nanoseconds (Column-major block)" << std::endl;
         }
+    }
+
+    /*!
+     * Time operator* against the in-place multiply() and multiply_transpose(), and count their heap allocations
+     * @param test_matrix Compressed matrix to time
+     * @param N Number of multiplications
+     */
+    template <typename T, StorageOrder Order, typename Index, typename Storage>
+    void timing_inplace(const Matrix<T, Order, Index, Storage> &test_matrix, std::size_t N = 50)
+    {
+        std::vector<T> x(test_matrix.get_columns(), 1);
+        std::vector<T> y(test_matrix.get_rows(), 0);
+        std::vector<T> x_transpose(test_matrix.get_rows(), 1);
+        std::vector<T> y_transpose(test_matrix.get_columns(), 0);
 
-        // Stop measuring time
+        auto time = [N](const char *name, auto &&multiply)
+        {
+            std::size_t allocations = memory::allocations();
+            auto start = std::chrono::high_resolution_clock::now();
+            for (std::size_t i = 0; i < N; i++)
+            {
+                multiply();
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+            std::cout << name << std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / double(N)
+                      << " nanoseconds, " << double(memory::allocations() - allocations) / N << " allocations per call" << std::endl;
+        };
+
+        time("operator*: ", [&]()
+             { y = test_matrix * x; });
+        time("multiply: ", [&]()
+             { test_matrix.multiply(x, y); });
+        time("multiply with alpha and beta: ", [&]()
+             { test_matrix.multiply(x, y, 2.0, 0.5); });
+        time("multiply_transpose: ", [&]()
+             { test_matrix.multiply_transpose(x_transpose, y_transpose); });
+    }
+
+    /*!
+     * Time the fused multiply_dot() against multiply() followed by a dot product, then solve a system with the
+     * iterative solvers and their preconditioners, reporting iterations, residual and time per iteration
+     * @param test_matrix Square compressed matrix, symmetric positive definite for the conjugate gradient
+     * @param N Number of multiplications
+     */
+    template <typename T, StorageOrder Order, typename Index, typename Storage>
+    void timing_solvers(const Matrix<T, Order, Index, Storage> &test_matrix, std::size_t N = 50)
+    {
+        const std::size_t n = test_matrix.get_rows();
+        std::vector<T> x(n, 1), y(n, 0);
+        T checksum = 0;
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (std::size_t i = 0; i < N; i++)
+        {
+            test_matrix.multiply(x, y);
+            for (std::size_t k = 0; k < n; ++k)
+            {
+                checksum += x[k] * y[k];
+            }
+        }
         auto end = std::chrono::high_resolution_clock::now();
+        double separate_time = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / double(N);
+
+        start = std::chrono::high_resolution_clock::now();
+        for (std::size_t i = 0; i < N; i++)
+        {
+            checksum += test_matrix.multiply_dot(x, y, x);
+        }
+        end = std::chrono::high_resolution_clock::now();
+        double fused_time = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / double(N);
+
+        std::cout << "multiply and dot: " << separate_time << " nanoseconds, multiply_dot: " << fused_time
+                  << " nanoseconds (checksum " << checksum << ")" << std::endl;
+
+        std::vector<T> b(n, 1);
+        SolverOptions options;
+        options.record_history = true;
+        JacobiPreconditioner<T> jacobi(test_matrix);
+        ILU0Preconditioner<T> ilu(test_matrix);
+
+        auto report = [&](const char *name, auto &&solve)
+        {
+            std::vector<T> solution(n, 0);
+            std::size_t allocations = memory::allocations();
+            SolverResult result = solve(solution);
+            allocations = memory::allocations() - allocations;
+
+            // Slowest iteration from the time history
+            double slowest = 0;
+            for (std::size_t k = 1; k < result.time_history.size(); ++k)
+            {
+                slowest = std::max(slowest, result.time_history[k] - result.time_history[k - 1]);
+            }
+            std::cout << name << (result.converged ? ": converged in " : ": not converged after ") << result.iterations
+                      << " iterations, residual " << result.residual << ", "
+                      << result.time / std::max<std::size_t>(1, result.iterations) << " nanoseconds per iteration (slowest "
+                      << slowest << "), " << allocations << " allocations" << std::endl;
+        };
+
+        report("CG", [&](std::vector<T> &solution)
+               { return conjugate_gradient<T>(test_matrix, b, solution, IdentityPreconditioner<T>(), options); });
+        report("CG + Jacobi", [&](std::vector<T> &solution)
+               { return conjugate_gradient<T>(test_matrix, b, solution, jacobi, options); });
+        report("CG + ILU(0)", [&](std::vector<T> &solution)
+               { return conjugate_gradient<T>(test_matrix, b, solution, ilu, options); });
+        report("BiCGSTAB + ILU(0)", [&](std::vector<T> &solution)
+               { return bicgstab<T>(test_matrix, b, solution, ilu, options); });
+        // GMRES(30) stagnates on the grid Laplacian, a larger Krylov subspace converges
+        SolverOptions gmres_options = options;
+        gmres_options.restart = 150;
+        report("GMRES(150) + ILU(0)", [&](std::vector<T> &solution)
+               { return gmres<T>(test_matrix, b, solution, ilu, gmres_options); });
+    }
+
+    /*!
+     * Build a small compressed matrix from random entries, with repetitions
+     * @param n_rows Number of rows
+     * @param n_columns Number of columns
+     * @param n_entries Number of entries
+     * @param seed Seed of the generator
+     */
+    template <StorageOrder Order>
+    Matrix<double, Order> random_matrix(std::size_t n_rows, std::size_t n_columns, std::size_t n_entries, unsigned seed)
+    {
+        std::mt19937_64 generator(seed);
+        std::uniform_int_distribution<std::size_t> row(0, n_rows - 1);
+        std::uniform_int_distribution<std::size_t> column(0, n_columns - 1);
+        std::uniform_real_distribution<double> value(-1.0, 1.0);
+
+        Matrix<double, Order> matrix(n_rows, n_columns);
+        for (std::size_t e = 0; e < n_entries; ++e)
+        {
+            // Row drawn first, the evaluation order of the arguments is unspecified
+            std::size_t i = row(generator);
+            std::size_t j = column(generator);
+            matrix.add(i, j, value(generator));
+        }
+        matrix.compress();
+        return matrix;
+    }
+
+    /*!
+     * Dense row-major copy of a matrix, read with the const operator()
+     */
+    template <typename T, StorageOrder Order, typename Index, typename Storage>
+    std::vector<T> to_dense(const Matrix<T, Order, Index, Storage> &matrix)
+    {
+        std::vector<T> dense(matrix.get_rows() * matrix.get_columns());
+        for (std::size_t i = 0; i < matrix.get_rows(); ++i)
+        {
+            for (std::size_t j = 0; j < matrix.get_columns(); ++j)
+            {
+                dense[i * matrix.get_columns() + j] = matrix(i, j);
+            }
+        }
+        return dense;
+    }
+
+    /*!
+     * Check transpose, conversion to the other storage order, sum and product of small rectangular matrices
+     * against the same operations on their dense copies, serially and on 3 threads
+     */
+    template <StorageOrder Order>
+    void test_sparse_operations()
+    {
+        constexpr StorageOrder OtherOrder = (Order == StorageOrder::ROWMAJOR) ? StorageOrder::COLMAJOR : StorageOrder::ROWMAJOR;
+        const std::size_t m = 13, k = 9, n = 11;
+
+        for (std::size_t n_threads : {1, 3})
+        {
+            auto A = random_matrix<Order>(m, k, 50, 1);
+            auto B = random_matrix<Order>(k, n, 40, 2);
+            auto C = random_matrix<Order>(m, k, 30, 3);
+            A.set_threads(n_threads);
+            const std::vector<double> a = to_dense(A), b = to_dense(B), c = to_dense(C);
+
+            std::vector<double> a_transpose(k * m);
+            for (std::size_t i = 0; i < m; ++i)
+            {
+                for (std::size_t j = 0; j < k; ++j)
+                {
+                    a_transpose[j * m + i] = a[i * k + j];
+                }
+            }
+            auto At = transpose(A);
+            check(At.get_rows() == k && At.get_columns() == m && to_dense(At) == a_transpose, "transpose against the dense transpose");
+            check(to_dense(convert<OtherOrder>(A)) == a, "conversion to the other storage order");
+
+            std::vector<double> sum(m * k);
+            for (std::size_t p = 0; p < m * k; ++p)
+            {
+                sum[p] = 2.0 * a[p] - 0.5 * c[p];
+            }
+            check(max_difference(to_dense(add(A, C, 2.0, -0.5)), sum) <= 1e-14, "sum against the dense sum");
+
+            std::vector<double> product(m * n, 0);
+            for (std::size_t i = 0; i < m; ++i)
+            {
+                for (std::size_t l = 0; l < k; ++l)
+                {
+                    for (std::size_t j = 0; j < n; ++j)
+                    {
+                        product[i * n + j] += a[i * k + l] * b[l * n + j];
+                    }
+                }
+            }
+            auto AB = A * B;
+            check(AB.get_rows() == m && AB.get_columns() == n && max_difference(to_dense(AB), product) <= 1e-13, "operator* against the dense product");
+
+            // Numeric phase again on new values of the same patterns
+            SparseProduct<double, Order, std::uint32_t, double> pattern(A, B);
+            for (auto &value : A.get_mutable_values())
+            {
+                value *= -3.0;
+            }
+            pattern.compute(A, B, AB);
+            for (auto &value : product)
+            {
+                value *= -3.0;
+            }
+            check(max_difference(to_dense(AB), product) <= 1e-13, "numeric phase of SparseProduct against the dense product");
+        }
+        std::cout << "Sparse operations agree with the dense ones" << std::endl;
+    }
+
+    /*!
+     * Time transpose, conversion to the other storage order, sum and the product A * A,
+     * with the symbolic and the numeric phases of the product timed separately
+     * @param test_matrix Square compressed matrix
+     * @param N Number of repetitions
+     */
+    template <typename T, StorageOrder Order, typename Index, typename Storage>
+    void timing_sparse_operations(const Matrix<T, Order, Index, Storage> &test_matrix, std::size_t N = 10)
+    {
+        constexpr StorageOrder OtherOrder = (Order == StorageOrder::ROWMAJOR) ? StorageOrder::COLMAJOR : StorageOrder::ROWMAJOR;
+
+        auto time = [N](const char *name, auto &&operation)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            for (std::size_t i = 0; i < N; i++)
+            {
+                operation();
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+            std::cout << name << std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / double(N) << " nanoseconds" << std::endl;
+        };
 
-        // Calculate duration
-        auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start) / 100;
+        time("transpose: ", [&]()
+             { transpose(test_matrix); });
+        time("convert to the other order: ", [&]()
+             { convert<OtherOrder>(test_matrix); });
+        time("A + A^T: ", [&]()
+             { test_matrix + transpose(test_matrix); });
 
-        // Output the execution time
-        std::cout << "Average execution time: " << duration.count() << " nanoseconds" << std::endl;
+        SparseProduct<T, Order, Index, Storage> product(test_matrix, test_matrix);
+        Matrix<T, Order, Index, Storage> square = product.compute(test_matrix, test_matrix);
+        std::cout << "A * A has " << product.get_nnz() << " non-zero elements" << std::endl;
+        time("A * A, symbolic phase: ", [&]()
+             { SparseProduct<T, Order, Index, Storage>(test_matrix, test_matrix); });
+        time("A * A, numeric phase: ", [&]()
+             { product.compute(test_matrix, test_matrix, square); });
+    }
 
-        return duration.count();
+    /*!
+     * Check the symmetric storage of A + A^T against the full matrix: elements and products with alpha and beta,
+     * built from both storage orders and from a Matrix Market file declared symmetric, on 1 and 3 threads
+     */
+    template <StorageOrder Order>
+    void test_symmetric()
+    {
+        const std::size_t n = 17;
+        auto random = random_matrix<Order>(n, n, 60, 4);
+        const auto full = random + transpose(random);
+        const std::string mtx_path = (std::filesystem::temp_directory_path() / "pacs_symmetric.mtx").string();
+
+        // Lower triangle in a Matrix Market file declared symmetric
+        {
+            std::ofstream myfile(mtx_path);
+            myfile.precision(17);
+            std::size_t n_lower = 0;
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                for (std::size_t j = 0; j <= i; ++j)
+                {
+                    n_lower += (full(i, j) != 0);
+                }
+            }
+            myfile << "%%MatrixMarket matrix coordinate real symmetric\n";
+            myfile << n << " " << n << " " << n_lower << "\n";
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                for (std::size_t j = 0; j <= i; ++j)
+                {
+                    if (full(i, j) != 0)
+                    {
+                        myfile << i + 1 << " " << j + 1 << " " << full(i, j) << "\n";
+                    }
+                }
+            }
+        }
+        SymmetricMatrix<double> from_file;
+        from_file.read_from_file(mtx_path);
+        std::remove(mtx_path.c_str());
+
+        std::vector<double> x(n), y(n), y_full(n);
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            x[i] = 1.0 + double(i % 5) / 4;
+        }
+
+        for (std::size_t n_threads : {1, 3})
+        {
+            for (const SymmetricMatrix<double> &symmetric : {SymmetricMatrix<double>(full), from_file})
+            {
+                SymmetricMatrix<double> threaded = symmetric;
+                threaded.set_threads(n_threads);
+                check(threaded.get_nnz() == full.get_nnz(), "non-zero elements of the symmetric storage");
+                for (std::size_t i = 0; i < n; ++i)
+                {
+                    for (std::size_t j = 0; j < n; ++j)
+                    {
+                        check(threaded(i, j) == full(i, j), "element of the symmetric storage");
+                    }
+                }
+
+                std::fill(y.begin(), y.end(), 1.0);
+                std::fill(y_full.begin(), y_full.end(), 1.0);
+                threaded.multiply(x, y, 2.0, 0.5);
+                full.multiply(x, y_full, 2.0, 0.5);
+                check(max_difference(y, y_full) <= 1e-13, "symmetric product against the full product");
+            }
+        }
+        std::cout << "Symmetric storage agrees with the full matrix" << std::endl;
+    }
+
+    /*!
+     * Compare the storage and the in-place matrix-vector multiplication of a symmetric matrix
+     * stored in full and as diagonal plus lower triangle
+     * @param test_matrix Square compressed symmetric matrix
+     * @param N Number of multiplications
+     */
+    template <typename T, StorageOrder Order, typename Index, typename Storage>
+    void timing_symmetric(const Matrix<T, Order, Index, Storage> &test_matrix, std::size_t N = 50)
+    {
+        SymmetricMatrix<T, Index, Storage> symmetric(test_matrix);
+        std::vector<T> x(test_matrix.get_columns(), 1), y(test_matrix.get_rows());
+
+        auto time = [&](auto &&multiply)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            for (std::size_t i = 0; i < N; i++)
+            {
+                multiply();
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / double(N);
+        };
+
+        const double full_bytes = test_matrix.get_nnz() * (sizeof(Index) + sizeof(Storage)) + test_matrix.get_offsets().size() * sizeof(Index);
+        const double symmetric_bytes = symmetric.get_values().size() * (sizeof(Index) + sizeof(Storage)) + symmetric.get_offsets().size() * sizeof(Index) + symmetric.get_diagonal().size() * sizeof(Storage);
+        std::cout << "Storage: full " << full_bytes / (1 << 20) << " MiB, symmetric " << symmetric_bytes / (1 << 20) << " MiB" << std::endl;
+
+        double full_time = time([&]()
+                                { test_matrix.multiply(x, y); });
+        std::cout << "Full: " << full_time << " nanoseconds" << std::endl;
+        double symmetric_time = time([&]()
+                                     { symmetric.multiply(x, y); });
+        std::cout << "Symmetric: " << symmetric_time << " nanoseconds - speedup: " << full_time / symmetric_time << std::endl;
+    }
+
+    /*!
+     * Time the update of all the values of a compressed matrix with a fixed pattern: through the map of the uncompressed matrix,
+     * with accumulate() and with assemble() on the threads of the matrix
+     * @param test_matrix Compressed matrix whose pattern and values are assembled again
+     * @param N Number of updates
+     */
+    template <typename T, StorageOrder Order, typename Index, typename Storage>
+    void timing_update(const Matrix<T, Order, Index, Storage> &test_matrix, std::size_t N = 10)
+    {
+        // Entries of the matrix, in the order of the compressed storage
+        std::vector<Triplet<T>> entries;
+        entries.reserve(test_matrix.get_nnz());
+        const auto &offsets = test_matrix.get_offsets();
+        const auto &indices = test_matrix.get_indices();
+        const auto &values = test_matrix.get_values();
+        for (std::size_t m = 0; m + 1 < offsets.size(); ++m)
+        {
+            for (std::size_t k = offsets[m]; k < offsets[m + 1]; ++k)
+            {
+                std::size_t i = (Order == StorageOrder::ROWMAJOR) ? m : indices[k];
+                std::size_t j = (Order == StorageOrder::ROWMAJOR) ? indices[k] : m;
+                entries.push_back({i, j, static_cast<T>(values[k])});
+            }
+        }
+
+        Matrix<T, Order, Index, Storage> matrix = test_matrix;
+        auto time = [&](const char *name, auto &&update)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            for (std::size_t i = 0; i < N; i++)
+            {
+                update();
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+            std::cout << name << std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / double(N) << " nanoseconds" << std::endl;
+        };
+
+        time("uncompress, set and compress: ", [&]()
+             {
+            matrix.uncompress();
+            for (const auto &t : entries)
+            {
+                matrix(t.row, t.column) = t.value;
+            }
+            matrix.compress(); });
+        check(same_compressed(matrix, test_matrix), "uncompress, set and compress against the original matrix");
+
+        auto reset = [&]()
+        {
+            auto matrix_values = matrix.get_mutable_values();
+            std::fill(matrix_values.begin(), matrix_values.end(), Storage(0));
+        };
+        time("accumulate into the pattern: ", [&]()
+             {
+            reset();
+            for (const auto &t : entries)
+            {
+                matrix.accumulate(t.row, t.column, t.value);
+            } });
+        check(same_compressed(matrix, test_matrix), "accumulate against the original matrix");
+        time("assemble into the pattern: ", [&]()
+             {
+            reset();
+            const std::size_t n_threads = matrix.get_threads();
+            parallel_for(n_threads, [&](std::size_t t)
+                         { matrix.assemble(std::span<const Triplet<T>>(entries).subspan(t * entries.size() / n_threads, (t + 1) * entries.size() / n_threads - t * entries.size() / n_threads)); }); });
+
+        // Each element is added once to zero, so the sums are exact whatever their order
+        check(same_compressed(matrix, test_matrix), "assemble against the original matrix");
+        reset();
+        parallel_for(4, [&](std::size_t t)
+                     { matrix.assemble(std::span<const Triplet<T>>(entries).subspan(t * entries.size() / 4, (t + 1) * entries.size() / 4 - t * entries.size() / 4)); });
+        check(same_compressed(matrix, test_matrix), "assemble on 4 threads against the original matrix");
+
+        // An element outside the pattern, assembled by a worker, reaches the caller as std::runtime_error
+        std::size_t i_outside = 0, j_outside = 0;
+        while (j_outside < test_matrix.get_columns() && test_matrix(i_outside, j_outside) != T(0))
+        {
+            ++j_outside;
+        }
+        if (j_outside < test_matrix.get_columns())
+        {
+            const Triplet<T> outside{i_outside, j_outside, T(1)};
+            bool thrown = false;
+            try
+            {
+                parallel_for(2, [&](std::size_t t)
+                             { if (t == 1) matrix.assemble(std::span<const Triplet<T>>(&outside, 1)); });
+            }
+            catch (const std::runtime_error &)
+            {
+                thrown = true;
+            }
+            check(thrown, "assemble of an element outside the pattern");
+        }
+        std::cout << "Updated values agree with the original matrix" << std::endl;
     }
-}
\ No newline at end of file
+}
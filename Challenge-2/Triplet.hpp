@@ -0,0 +1,20 @@
+#ifndef TRIPLET_HPP
+#define TRIPLET_HPP
+
+#include <cstddef>
+
+namespace algebra
+{
+    /*!
+     * Entry of a matrix in coordinate (COO) format
+     */
+    template <typename T>
+    struct Triplet
+    {
+        std::size_t row;
+        std::size_t column;
+        T value;
+    };
+}
+
+#endif
@@ -11,18 +11,104 @@ int main()
     Matrix<double, StorageOrder::COLMAJOR> test_matrix_col(1, 1);
     test_matrix_col.read_from_file(file_path);
 
-    // Timiming the matrix vector multiplication for non compressed matrix
-    std::cout << "Matrix Row-major not compressed:"<<std::endl;
-    timing_matrix(test_matrix_row);
-    std::cout << "Matrix Column-major not compressed:"<<std::endl;
-    timing_matrix(test_matrix_col);
-
-    // Timiming the matrix vector multiplication for compressed matrix
+    // Timing the matrix vector multiplication for the non compressed and the compressed matrix
+    BenchmarkOptions options;
+    BenchmarkReport report;
+    benchmark_multiply(report, "lnsp_131", test_matrix_row, options);
+    benchmark_multiply(report, "lnsp_131", test_matrix_col, options);
     test_matrix_row.compress();
     test_matrix_col.compress();
-    std::cout << "Matrix Row-major compressed:"<<std::endl;
-    timing_matrix(test_matrix_col);
-    std::cout << "Matrix Column-major compressed:"<<std::endl;
-    timing_matrix(test_matrix_col);
+    benchmark_multiply(report, "lnsp_131", test_matrix_row, options);
+    benchmark_multiply(report, "lnsp_131", test_matrix_col, options);
+
+    // Timing the parallel matrix vector multiplication on a larger banded matrix
+    std::size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+    auto banded_row = banded_matrix<StorageOrder::ROWMAJOR>(200000, 4);
+    auto banded_col = banded_matrix<StorageOrder::COLMAJOR>(200000, 4);
+    banded_row.compress();
+    banded_col.compress();
+    test_parallel(banded_row);
+    test_parallel(banded_col);
+    std::cout << "Banded matrix Row-major compressed, parallel:" << std::endl;
+    timing_threads(banded_row, max_threads);
+    std::cout << "Banded matrix Column-major compressed, parallel:" << std::endl;
+    timing_threads(banded_col, max_threads);
+
+    // Timing the assembly of a matrix with repeated entries
+    std::size_t n_assembly = 500000;
+    auto entries = random_entries(n_assembly, 10, 2000000);
+    std::cout << "Assembly of a Row-major matrix with " << entries.size() << " entries:" << std::endl;
+    timing_assembly<StorageOrder::ROWMAJOR>(entries, n_assembly);
+
+    // Timing the access to the elements of a compressed matrix with long rows
+    auto wide_banded = banded_matrix<StorageOrder::ROWMAJOR>(2000, 100);
+    wide_banded.compress();
+    std::cout << "Element access on a Row-major compressed banded matrix:" << std::endl;
+    timing_access(wide_banded, 1000000);
+
+    // Timing the reading of a large Matrix Market file
+    std::cout << "Reading a Row-major banded matrix:" << std::endl;
+    timing_reading<StorageOrder::ROWMAJOR>(200000, 4);
+
+    // Timing the SELL-C-sigma kernels against CSR
+    Matrix<double, StorageOrder::ROWMAJOR> fem_like(n_assembly, n_assembly);
+    for (const auto &t : entries)
+    {
+        fem_like.add(t.row, t.column, t.value);
+    }
+    fem_like.compress();
+    std::cout << "SELL-C-sigma multiplication on the assembled matrix:" << std::endl;
+    timing_sell(fem_like);
+    std::cout << "SELL-C-sigma multiplication on the banded matrix:" << std::endl;
+    timing_sell(banded_row);
+
+    // Timing the multiplication with different index and value types
+    std::cout << "Bandwidth of the Row-major banded matrix:" << std::endl;
+    auto banded_64 = banded_matrix<StorageOrder::ROWMAJOR, std::size_t>(1000000, 4);
+    auto banded_32 = banded_matrix<StorageOrder::ROWMAJOR, std::uint32_t>(1000000, 4);
+    auto banded_float = banded_matrix<StorageOrder::ROWMAJOR, std::uint32_t, float>(1000000, 4);
+    banded_64.compress();
+    banded_32.compress();
+    banded_float.compress();
+    timing_bandwidth(banded_64);
+    timing_bandwidth(banded_32);
+    timing_bandwidth(banded_float);
+
+    // Timing the multiplication by blocks of vectors
+    std::cout << "Matrix-block multiplication on the Row-major banded matrix:" << std::endl;
+    timing_block(banded_row, 32);
+    std::cout << "Matrix-block multiplication on the Column-major banded matrix:" << std::endl;
+    timing_block(banded_col, 32);
+
+    // Timing the in-place multiplication
+    std::cout << "In-place multiplication on the Row-major banded matrix:" << std::endl;
+    timing_inplace(banded_row);
+    std::cout << "In-place multiplication on the Column-major banded matrix:" << std::endl;
+    timing_inplace(banded_col);
+
+    // Timing the iterative solvers on a grid Laplacian
+    Matrix<double, StorageOrder::ROWMAJOR> laplacian(300 * 300, 300 * 300);
+    for (const auto &t : grid_entries(300))
+    {
+        laplacian.add(t.row, t.column, t.value);
+    }
+    laplacian.compress();
+    std::cout << "Iterative solvers on a 300x300 grid Laplacian:" << std::endl;
+    timing_solvers(laplacian);
+
+    // Timing the sparse matrix-matrix operations
+    test_sparse_operations<StorageOrder::ROWMAJOR>();
+    test_sparse_operations<StorageOrder::COLMAJOR>();
+    std::cout << "Sparse operations on the grid Laplacian:" << std::endl;
+    timing_sparse_operations(laplacian);
+
+    // Timing the symmetric storage
+    test_symmetric<StorageOrder::ROWMAJOR>();
+    test_symmetric<StorageOrder::COLMAJOR>();
+    std::cout << "Symmetric storage of the grid Laplacian:" << std::endl;
+    timing_symmetric(laplacian);
 
-}
\ No newline at end of file
+    // Timing the update of the values with a fixed pattern
+    std::cout << "Update of the values of the grid Laplacian:" << std::endl;
+    timing_update(laplacian);
+}
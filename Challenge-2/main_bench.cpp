@@ -0,0 +1,108 @@
+#include <cmath>
+#include <cstdlib>
+#include <tuple>
+#include "Benchmark.hpp"
+#include "MemoryTracker.hpp"
+
+using namespace algebra;
+
+/*
+ * Benchmark suite of the matrix: assembly, compress, uncompress, random access and matrix-vector
+ * multiplication on banded, uniformly random and power-law matrices, in both storage orders,
+ * and reverse Cuthill-McKee reordering of randomly numbered matrices.
+ *
+ * Usage: ./main_bench [--size n] [--repetitions r] [--warmup w] [--threads t] [--csv file]
+ */
+int main(int argc, char **argv)
+{
+    BenchmarkOptions options;
+    std::size_t n = 200000;
+    std::string csv_path = "bench.csv";
+
+    for (int a = 1; a < argc; ++a)
+    {
+        std::string option = argv[a];
+        if (a + 1 >= argc)
+        {
+            std::cerr << "Missing value for " << option << std::endl;
+            return EXIT_FAILURE;
+        }
+        std::string value = argv[++a];
+
+        if (option == "--size")
+        {
+            n = std::stoul(value);
+        }
+        else if (option == "--repetitions")
+        {
+            options.repetitions = std::stoul(value);
+        }
+        else if (option == "--warmup")
+        {
+            options.warmup = std::stoul(value);
+        }
+        else if (option == "--threads")
+        {
+            options.n_threads = std::stoul(value);
+        }
+        else if (option == "--csv")
+        {
+            csv_path = value;
+        }
+        else
+        {
+            std::cerr << "Unknown option " << option << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    BenchmarkReport report;
+
+    // Small matrix of the challenge, read from file
+    std::string file_path = "./assets/lnsp_131.mtx";
+    Matrix<double, StorageOrder::ROWMAJOR> lnsp_row(1, 1);
+    Matrix<double, StorageOrder::COLMAJOR> lnsp_col(1, 1);
+    lnsp_row.read_from_file(file_path);
+    lnsp_col.read_from_file(file_path);
+    benchmark_multiply(report, "lnsp_131", lnsp_row, options);
+    benchmark_multiply(report, "lnsp_131", lnsp_col, options);
+    lnsp_row.compress();
+    lnsp_col.compress();
+    benchmark_multiply(report, "lnsp_131", lnsp_row, options);
+    benchmark_multiply(report, "lnsp_131", lnsp_col, options);
+
+    // Generated matrices with about 9 non-zero elements per row
+    const std::vector<std::pair<std::string, std::vector<Triplet<double>>>> matrices = {
+        {"banded", banded_entries(n, 4)},
+        {"uniform", uniform_entries(n, 9)},
+        {"power-law", power_law_entries(n, 9)}};
+
+    for (const auto &[name, entries] : matrices)
+    {
+        benchmark_suite<StorageOrder::ROWMAJOR>(report, name, n, entries, options);
+        benchmark_suite<StorageOrder::COLMAJOR>(report, name, n, entries, options);
+    }
+
+    // Bandwidth reduction of matrices with a poor numbering
+    benchmark_reordering(report, "lnsp_131", lnsp_row, options);
+
+    const std::size_t side = static_cast<std::size_t>(std::sqrt(double(n)));
+    const std::vector<std::tuple<std::string, std::size_t, std::vector<Triplet<double>>>> shuffled_matrices = {
+        {"grid-shuffled", side * side, shuffle_entries(grid_entries(side), side * side)},
+        {"banded-shuffled", n, shuffle_entries(banded_entries(n, 4), n)}};
+
+    for (const auto &[name, size, entries] : shuffled_matrices)
+    {
+        Matrix<double, StorageOrder::ROWMAJOR> shuffled(size, size);
+        shuffled.set_threads(options.n_threads);
+        for (const auto &t : entries)
+        {
+            shuffled.add(t.row, t.column, t.value);
+        }
+        shuffled.compress();
+        benchmark_reordering(report, name, shuffled, options);
+    }
+
+    report.write_csv(csv_path);
+    std::cout << "Results written to " << csv_path << ", peak memory " << memory::peak() / (1 << 20) << " MiB" << std::endl;
+}